@@ -283,6 +283,15 @@ SEXP selfrefokwrapper(SEXP x, SEXP verbose) {
 
 int *_Last_updated = NULL;
 
+static SEXP patchIndexByName(SEXP dt, SEXP names, const char *name, SEXP o, const int *rows, const int nrows)
+// name is the index name after its leading "__"; e.g. "col1__col2". R_NilValue when the index can't be patched.
+{
+  int cols[64];
+  const int ncol = indexColumns(names, name, cols);
+  if (!ncol) return R_NilValue;
+  return patchIndex(dt, o, length(VECTOR_ELT(dt,0)), cols, ncol, rows, nrows);
+}
+
 SEXP assign(SEXP dt, SEXP rows, SEXP cols, SEXP newcolnames, SEXP values)
 {
   // For internal use only by := in [.data.table, and set()
@@ -554,6 +563,8 @@ SEXP assign(SEXP dt, SEXP rows, SEXP cols, SEXP newcolnames, SEXP values)
     }
     //else: no key column changed, nothing to be done
   }
+  // when just a few rows were updated, the indices on the updated columns are patched rather than dropped; see patchindex.c
+  const bool patch = !isNull(rows) && numToDo>0 && numToDo<=nrow/100;
   index = getAttrib(dt, install("index"));
   if (index != R_NilValue) {
     s = ATTRIB(index);
@@ -615,13 +626,25 @@ SEXP assign(SEXP dt, SEXP rows, SEXP cols, SEXP newcolnames, SEXP values)
         free(s5);
       }
       memset(s4 + newKeyLength, '\0', 1); // truncate the new key to the new length
+      if (patch && newKeyLength < (int)strlen(c1)) {
+        SEXP v = patchIndexByName(dt, names, c1+2, CAR(s), INTEGER(rows), length(rows));
+        if (!isNull(v)) {
+          SETCAR(s, v);
+          if (verbose)
+            Rprintf(_("Patched index '%s' for the update of %d rows\n"), c1+2, numToDo);
+          free(s4);
+          indexNo++;
+          s = CDR(s);
+          continue; // with next index
+        }
+      }
       if(newKeyLength == 0){ // no valid key column remains. Drop the key
         setAttrib(index, a, R_NilValue);
         SET_STRING_ELT(indexNames, indexNo, NA_STRING);
         if (verbose) {
           Rprintf(_("Dropping index '%s' due to an update on a key column\n"), c1+2);
         }
-      } else if(newKeyLength < strlen(c1)) {
+      } else if(newKeyLength < (int)strlen(c1)) {
         SEXP s4Str = PROTECT(mkString(s4));
         if(indexLength == 0 && // shortened index can be kept since it is just information on the order (see #2372)
            LOGICAL(chin(s4Str, indexNames))[0] == 0) {// index with shortened name not present yet
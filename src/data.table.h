@@ -104,6 +104,7 @@ extern SEXP sym_tzone;
 extern SEXP sym_old_fread_datetime_character;
 extern SEXP sym_variable_table;
 extern SEXP sym_as_character;
+extern SEXP sym_schema;
 extern double NA_INT64_D;
 extern long long NA_INT64_LL;
 extern Rcomplex NA_CPLX;  // initialized in init.c; see there for comments
@@ -136,8 +137,14 @@ int getNumericRounding_C();
 
 // reorder.c
 SEXP reorder(SEXP x, SEXP order);
+SEXP reorderIndices(SEXP x, SEXP order);
 SEXP setcolorder(SEXP x, SEXP o);
 
+// patchindex.c
+SEXP patchIndex(SEXP dt, SEXP o, const int nidx, const int *cols, const int ncol, const int *rows, const int nrows);
+bool sortIndexTies(SEXP dt, int *o, const int n, const int *cols, const int ncol);
+int indexColumns(SEXP names, const char *name, int *cols);
+
 // subset.c
 void subsetVectorRaw(SEXP ans, SEXP source, SEXP idx, const bool anyNA);
 SEXP subsetVector(SEXP x, SEXP idx);
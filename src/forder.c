@@ -42,8 +42,12 @@ static int *gs_thread_n=NULL;
 static int *TMP=NULL;               // UINT16_MAX*sizeof(int) for each thread; used by counting sort in radix_r()
 static uint8_t *UGRP=NULL;          // 256 bytes for each thread; used by counting sort in radix_r() when sortType==0 (byte appearance order)
 
-static int  *cradix_counts = NULL;
-static SEXP *cradix_xtmp   = NULL;
+typedef struct cstr cstr;
+static cstr *cradix_x   = NULL;
+static cstr *cradix_tmp = NULL;
+typedef struct runcol runcol;
+static runcol *runcols = NULL;      // the by= columns, when looking for sorted runs
+static int nruncol = 0;
 static SEXP *ustr = NULL;
 static int ustr_alloc = 0;
 static int ustr_n = 0;
@@ -89,8 +93,9 @@ static void cleanup() {
   free(UGRP); UGRP=NULL;
 
   nrow = 0;
-  free(cradix_counts); cradix_counts=NULL;
-  free(cradix_xtmp);   cradix_xtmp=NULL;
+  free(cradix_x);   cradix_x=NULL;
+  free(cradix_tmp); cradix_tmp=NULL;
+  free(runcols);    runcols=NULL;
   free_ustr();
   if (key!=NULL) { int i=0; while (key[i]!=NULL) free(key[i++]); }  // ==nradix, other than rare cases e.g. tests 1844.5-6 (#3940), and if a calloc fails
   free(key); key=NULL; nradix=0;
@@ -219,60 +224,157 @@ int StrCmp(SEXP x, SEXP y)
   return strcmp(CHAR(x), CHAR(y));  // bmerge calls ENC2UTF8 on x and y before passing here
 }
 
-static void cradix_r(SEXP *xsub, int n, int radix)
-// xsub is a unique set of CHARSXP, to be ordered by reference
-// First time, radix==0, and xsub==x. Then recursively moves SEXP together for cache efficiency.
-// Quite different to iradix because
-//   1) x is known to be unique so fits in cache (wide random access not an issue)
-//   2) they're variable length character strings
-//   3) no need to maintain o.  Just simply reorder x. No grps or push.
+// The strings are sorted as cstr so that the bytes being compared are next to each other in memory rather than behind a
+// CHAR() of each string on each pass. word holds 8 bytes of the string starting at byte (radix & ~7), the first in the
+// most significant byte so that words compare as the strings do, and 1 beyond the end of the string (as for "" before).
+// It is reloaded from CHAR() only when radix crosses a multiple of 8.
+struct cstr {
+  uint64_t word;
+  SEXP s;
+  int len;        // LENGTH(s)
+};
+
+#define CRADIX_SMALL 32      // insertion sort at or below this many strings
+#define CRADIX_PAR   65536   // above this many strings a pass is split over threads; below, a bin is sorted by one thread
+
+static inline uint64_t cradix_word(const cstr *e, const int from)
 {
-  if (n<=1) return;
-  int *thiscounts = cradix_counts + radix*256;
-  uint8_t lastx = 0;  // the last x is used to test its bin
-  for (int i=0; i<n; i++) {
-    lastx = radix<LENGTH(xsub[i]) ? (uint8_t)(CHAR(xsub[i])[radix]) : 1;  // no NA_STRING present,  1 for "" (could use 0 too maybe since NA_STRING not present)
-    thiscounts[ lastx ]++;
-  }
-  if (thiscounts[lastx]==n && radix<ustr_maxlen-1) {
-    cradix_r(xsub, n, radix+1);
-    thiscounts[lastx] = 0;  // all x same value, the rest must be 0 already, save the memset
-    return;
-  }
-  int itmp = thiscounts[0];
-  for (int i=1; i<256; i++) {
-    if (thiscounts[i]) thiscounts[i] = (itmp += thiscounts[i]);  // don't cummulate through 0s, important below
+  const uint8_t *p = (const uint8_t *)CHAR(e->s);
+  uint64_t w = 0;
+  for (int j=from; j<from+8; j++) w = (w<<8) | (j<e->len ? p[j] : 1);
+  return w;
+}
+
+#define CBYTE(e, radix) ((uint8_t)((e).word >> (56 - 8*((radix)&7))))
+
+static int cstr_cmp(const cstr *a, const cstr *b, const int from)
+// a and b are already known to be equal before the bytes held in word; from is the byte after word
+{
+  if (a->word != b->word) return a->word < b->word ? -1 : 1;
+  const int la=a->len, lb=b->len, l=la>lb ? la : lb;
+  if (from>=l) return 0;
+  const uint8_t *pa=(const uint8_t *)CHAR(a->s), *pb=(const uint8_t *)CHAR(b->s);
+  for (int j=from; j<l; j++) {
+    const int ca = j<la ? pa[j] : 1, cb = j<lb ? pb[j] : 1;
+    if (ca!=cb) return ca-cb;
   }
-  for (int i=n-1; i>=0; i--) {
-    uint8_t thisx = radix<LENGTH(xsub[i]) ? (uint8_t)(CHAR(xsub[i])[radix]) : 1;
-    cradix_xtmp[--thiscounts[thisx]] = xsub[i];
+  return 0;
+}
+
+static void cradix_seq(cstr *x, cstr *tmp, int n, int radix)
+// Single threaded, so that each thread can sort a different bin. Recurses into every bin but the largest and loops on
+// the largest, so the depth is at most log2(n) whatever the strings.
+{
+  int counts[256];
+  while (n>1 && radix<ustr_maxlen) {
+    if (radix>0 && (radix&7)==0) for (int i=0; i<n; i++) x[i].word = cradix_word(x+i, radix);
+    if (n<=CRADIX_SMALL) {
+      const int from = (radix & ~7) + 8;
+      for (int i=1; i<n; i++) {
+        const cstr e = x[i];
+        int j = i-1;
+        while (j>=0 && cstr_cmp(x+j, &e, from)>0) { x[j+1]=x[j]; j--; }
+        x[j+1] = e;
+      }
+      return;
+    }
+    memset(counts, 0, 256*sizeof(int));
+    for (int i=0; i<n; i++) counts[CBYTE(x[i], radix)]++;
+    if (counts[CBYTE(x[0], radix)]==n) { radix++; continue; }  // all the same byte here
+    for (int b=0, pos=0; b<256; b++) { const int c=counts[b]; counts[b]=pos; pos+=c; }
+    for (int i=0; i<n; i++) tmp[counts[CBYTE(x[i], radix)]++] = x[i];   // counts[b] is now the end of bin b
+    memcpy(x, tmp, n*sizeof(cstr));
+    int bigfrom=0, bign=0;
+    for (int b=0, from=0; b<256; b++) {
+      const int m = counts[b]-from;
+      if (m>bign) {
+        if (bign>1) cradix_seq(x+bigfrom, tmp+bigfrom, bign, radix+1);
+        bigfrom=from; bign=m;
+      } else if (m>1) {
+        cradix_seq(x+from, tmp+from, m, radix+1);
+      }
+      from = counts[b];
+    }
+    x+=bigfrom; tmp+=bigfrom; n=bign; radix++;
   }
-  memcpy(xsub, cradix_xtmp, n*sizeof(SEXP));
-  if (radix == ustr_maxlen-1) {
-    memset(thiscounts, 0, 256*sizeof(int));
+}
+
+static void cradix_par(cstr *x, cstr *tmp, const int n, int radix, const int nthr)
+// Like radix_r: while there are many strings each pass is split over the threads in contiguous blocks, then the bins of
+// the pass are handed out to the threads dynamically, so a thread which finishes a small bin takes the next one.
+{
+  for (;;) {
+    if (n<=CRADIX_PAR || nthr==1 || radix>=ustr_maxlen) { cradix_seq(x, tmp, n, radix); return; }
+    const int nblock = nthr, blocksize = (n-1)/nblock + 1;
+    int *counts = (int *)calloc(nblock*256, sizeof(int));
+    if (!counts) STOP(_("Failed to alloc cradix counts"));  // # nocov
+    const bool reload = radix>0 && (radix&7)==0;
+    #pragma omp parallel for num_threads(nthr)
+    for (int b=0; b<nblock; b++) {
+      const int from=b*blocksize, to=MIN(from+blocksize, n);
+      int *thiscounts = counts + b*256;
+      for (int i=from; i<to; i++) {
+        if (reload) x[i].word = cradix_word(x+i, radix);
+        thiscounts[CBYTE(x[i], radix)]++;
+      }
+    }
+    int binend[256], pos=0;
+    for (int v=0; v<256; v++) {
+      for (int b=0; b<nblock; b++) { const int c=counts[b*256+v]; counts[b*256+v]=pos; pos+=c; }
+      binend[v] = pos;
+    }
+    const uint8_t first = CBYTE(x[0], radix);
+    if (binend[first] - (first ? binend[first-1] : 0) == n) {  // all the same byte here
+      free(counts);
+      radix++;
+      continue;
+    }
+    #pragma omp parallel for num_threads(nthr)
+    for (int b=0; b<nblock; b++) {
+      const int from=b*blocksize, to=MIN(from+blocksize, n);
+      int *thiscounts = counts + b*256;
+      for (int i=from; i<to; i++) tmp[thiscounts[CBYTE(x[i], radix)]++] = x[i];
+    }
+    free(counts);
+    #pragma omp parallel for num_threads(nthr)
+    for (int b=0; b<nblock; b++) {
+      const int from=b*blocksize, to=MIN(from+blocksize, n);
+      if (to>from) memcpy(x+from, tmp+from, (to-from)*sizeof(cstr));
+    }
+    int binfrom[256], binn[256], nbin=0;
+    for (int v=0, from=0; v<256; v++) {
+      const int m = binend[v]-from;
+      if (m>CRADIX_PAR) cradix_par(x+from, tmp+from, m, radix+1, nthr);  // still large enough to split over the threads itself
+      else if (m>1) { binfrom[nbin]=from; binn[nbin]=m; nbin++; }
+      from = binend[v];
+    }
+    if (nbin) {  // num_threads(0) is not allowed; e.g. every bin was recursed into above or held one string
+      #pragma omp parallel for schedule(dynamic) num_threads(MIN(nthr, nbin))
+      for (int i=0; i<nbin; i++) cradix_seq(x+binfrom[i], tmp+binfrom[i], binn[i], radix+1);
+    }
     return;
   }
-  if (thiscounts[0] != 0) STOP(_("Logical error. counts[0]=%d in cradix but should have been decremented to 0. radix=%d"), thiscounts[0], radix);
-  itmp = 0;
-  for (int i=1; i<256; i++) {
-    if (thiscounts[i] == 0) continue;
-    int thisgrpn = thiscounts[i] - itmp;  // undo cumulate; i.e. diff
-    cradix_r(xsub+itmp, thisgrpn, radix+1);
-    itmp = thiscounts[i];
-    thiscounts[i] = 0;  // set to 0 now since we're here, saves memset afterwards. Important to do this ready for this memory's reuse
-  }
-  if (itmp<n-1) cradix_r(xsub+itmp, n-itmp, radix+1);  // final group
 }
 
 static void cradix(SEXP *x, int n)
+// x is a set of CHARSXP (no NA_STRING), ordered in place by reference
 {
-  cradix_counts = (int *)calloc(ustr_maxlen*256, sizeof(int));  // counts for the letters of left-aligned strings
-  if (!cradix_counts) STOP(_("Failed to alloc cradix_counts"));
-  cradix_xtmp = (SEXP *)malloc(ustr_n*sizeof(SEXP));
-  if (!cradix_xtmp) STOP(_("Failed to alloc cradix_tmp"));
-  cradix_r(x, n, 0);
-  free(cradix_counts); cradix_counts=NULL;
-  free(cradix_xtmp);   cradix_xtmp=NULL;
+  if (n<=1) return;
+  const int nthr = getDTthreads(n, true);
+  cradix_x = (cstr *)malloc(n*sizeof(cstr));
+  cradix_tmp = (cstr *)malloc(n*sizeof(cstr));
+  if (!cradix_x || !cradix_tmp) STOP(_("Failed to alloc cradix_x or cradix_tmp"));
+  #pragma omp parallel for num_threads(nthr)
+  for (int i=0; i<n; i++) {
+    cradix_x[i].s = x[i];
+    cradix_x[i].len = LENGTH(x[i]);
+    cradix_x[i].word = cradix_word(cradix_x+i, 0);
+  }
+  cradix_par(cradix_x, cradix_tmp, n, 0, nthr);
+  #pragma omp parallel for num_threads(nthr)
+  for (int i=0; i<n; i++) x[i] = cradix_x[i].s;
+  free(cradix_x);   cradix_x=NULL;
+  free(cradix_tmp); cradix_tmp=NULL;
 }
 
 static void range_str(SEXP *x, int n, uint64_t *out_min, uint64_t *out_max, int *out_na_count)
@@ -283,32 +385,101 @@ static void range_str(SEXP *x, int n, uint64_t *out_min, uint64_t *out_max, int
   if (ustr_n!=0) STOP(_("Internal error: ustr isn't empty when starting range_str: ustr_n=%d, ustr_alloc=%d"), ustr_n, ustr_alloc);  // # nocov
   if (ustr_maxlen!=0) STOP(_("Internal error: ustr_maxlen isn't 0 when starting range_str"));  // # nocov
   // savetl_init() has already been called at the start of forder
-  #pragma omp parallel for num_threads(getDTthreads(n, true))
+  // Each thread takes a contiguous part of x and claims each string it sees first by writing its own tag (-1-me) to the
+  // string's TRUELENGTH and noting it in its own buffer, without a lock. Two threads can claim the same string at the same
+  // time; the one that wrote last keeps it, and the others drop it in the second pass. The third pass then places the
+  // strings each thread kept in ustr, after those kept by the threads before it, with their final TRUELENGTH. Only a
+  // string with R's own (positive) truelength, which savetl() must save exactly once, is claimed in a critical section.
+  // With one thread there is nobody to race with, so the final TRUELENGTH is written straight away and the buffer is ustr.
+  const int nthr = getDTthreads(n, true);
+  SEXP *thbuf[nthr];
+  int thn[nthr], thalloc[nthr], thmaxlen[nthr];
+  bool thneedutf8[nthr];
+  for (int t=0; t<nthr; t++) { thbuf[t]=NULL; thn[t]=thalloc[t]=thmaxlen[t]=0; thneedutf8[t]=false; }
+  bool failed = false;
+  #pragma omp parallel for schedule(static) num_threads(nthr) reduction(+:na_count)
   for(int i=0; i<n; i++) {
     SEXP s = x[i];
     if (s==NA_STRING) {
-      #pragma omp atomic update
       na_count++;
       continue;
     }
-    if (TRUELENGTH(s)<0) continue;  // seen this group before
-    #pragma omp critical
-    if (TRUELENGTH(s)>=0) {  // another thread may have set it while I was waiting, so check it again
-      if (TRUELENGTH(s)>0)   // save any of R's own usage of tl (assumed positive, so we can both count and save in one scan), to restore
-        savetl(s);           // afterwards. From R 2.14.0, tl is initialized to 0, prior to that it was random so this step saved too much.
-      // now save unique SEXP in ustr so i) we can loop through them afterwards and reset TRUELENGTH to 0 and ii) sort uniques when sorting too
-      if (ustr_alloc<=ustr_n) {
-        ustr_alloc = (ustr_alloc==0) ? 16384 : ustr_alloc*2;  // small initial guess, negligible time to alloc 128KB (32 pages)
-        if (ustr_alloc>n) ustr_alloc = n;  // clamp at n. Reaches n when fully unique (no dups)
-        ustr = realloc(ustr, ustr_alloc * sizeof(SEXP));
-        if (ustr==NULL) STOP(_("Unable to realloc %d * %d bytes in range_str"), ustr_alloc, (int)sizeof(SEXP));  // # nocov
+    R_len_t tl = TRUELENGTH(s);
+    if (tl<0) continue;  // seen this group before, by this thread or another
+    const int me = omp_get_thread_num();
+    if (thn[me]==thalloc[me]) {
+      int newalloc = thalloc[me]==0 ? 16384 : thalloc[me]*2;  // small initial guess, negligible time to alloc 128KB (32 pages)
+      if (newalloc>n) newalloc = n;
+      SEXP *tt = realloc(thbuf[me], newalloc*sizeof(SEXP));
+      if (!tt) { failed=true; continue; }  // # nocov. Not claimed so it need not be reset; STOP after the loop
+      thbuf[me] = tt;
+      thalloc[me] = newalloc;
+    }
+    const int tag = nthr==1 ? -thn[0]-1 : -1-me;
+    if (tl>0) {
+      bool claimed = false;
+      #pragma omp critical(range_str_savetl)
+      if (TRUELENGTH(s)>0) {  // another thread may have claimed it while I was waiting, so check it again
+        savetl(s);            // save R's own usage of tl to restore afterwards. From R 2.14.0, tl is initialized to 0.
+        SET_TRUELENGTH(s, tag);
+        claimed = true;
       }
-      ustr[ustr_n++] = s;
-      SET_TRUELENGTH(s, -ustr_n);  // unique in any order is fine. first-appearance order is achieved later in count_group
-      if (LENGTH(s)>ustr_maxlen) ustr_maxlen=LENGTH(s);
-      if (!anyneedutf8 && NEED2UTF8(s)) anyneedutf8=true;
+      if (!claimed) continue;
+    } else {
+      SET_TRUELENGTH(s, tag);
+    }
+    thbuf[me][thn[me]++] = s;
+    // a string claimed by two threads is counted by both here, which is fine for these two
+    if (LENGTH(s)>thmaxlen[me]) thmaxlen[me]=LENGTH(s);
+    if (!thneedutf8[me] && NEED2UTF8(s)) thneedutf8[me]=true;
+  }
+  if (nthr>1) {
+    // keep the strings whose tag is still this thread's
+    #pragma omp parallel for num_threads(nthr)
+    for (int t=0; t<nthr; t++) {
+      int k=0;
+      for (int i=0; i<thn[t]; i++) {
+        SEXP s = thbuf[t][i];
+        if (TRUELENGTH(s) == -1-t) thbuf[t][k++] = s;
+      }
+      thn[t] = k;
+    }
+  }
+  int off[nthr], total=0;
+  for (int t=0; t<nthr; t++) {
+    off[t] = total;
+    total += thn[t];
+    if (thmaxlen[t]>ustr_maxlen) ustr_maxlen=thmaxlen[t];
+    anyneedutf8 |= thneedutf8[t];
+  }
+  if (!failed && nthr==1) {
+    ustr = thbuf[0];  // NULL when all NA
+    ustr_alloc = thalloc[0];
+  } else if (!failed) {
+    ustr_alloc = total==0 ? 1 : total;
+    ustr = malloc(ustr_alloc * sizeof(SEXP));
+  }
+  if (failed || (!ustr && total)) {
+    // # nocov start
+    for (int t=0; t<nthr; t++) {
+      for (int i=0; i<thn[t]; i++) SET_TRUELENGTH(thbuf[t][i], 0);  // every string claimed is kept by exactly one thread
+      free(thbuf[t]);
+    }
+    STOP(_("Unable to allocate %d * %d bytes in range_str"), total, (int)sizeof(SEXP));
+    // # nocov end
+  }
+  if (nthr>1) {
+    #pragma omp parallel for num_threads(nthr)
+    for (int t=0; t<nthr; t++) {
+      for (int i=0; i<thn[t]; i++) {
+        SEXP s = thbuf[t][i];
+        ustr[off[t]+i] = s;
+        SET_TRUELENGTH(s, -(off[t]+i+1));  // unique in any order is fine. first-appearance order is achieved later in count_group
+      }
+      free(thbuf[t]);
     }
   }
+  ustr_n = total;
   *out_na_count = na_count;
   if (ustr_n==0) {  // all na
     *out_min = 0;
@@ -404,6 +575,195 @@ uint64_t dtwiddle(double x) //const void *p, int i)
   STOP(_("Unknown non-finite value; not NA, NaN, -Inf or +Inf"));  // # nocov
 }
 
+// Sorted and nearly sorted input; e.g. a time series appended in order with some late arrivals. Before building the keys for
+// the radix sort, the ascending runs of the input are found in parallel by comparing each row to the one before it. When the
+// input is one run it is already sorted. When it is a few runs they are merged pairwise, timsort-style, and the keys are not
+// built at all. Otherwise, as soon as a thread has found too many runs in its part, the radix sort proceeds as before.
+#define MAX_RUNS 1024
+
+enum {RUN_INT, RUN_DBL, RUN_I64, RUN_STR};
+struct runcol {
+  int type;
+  int asc;        // +1 or -1
+  const void *x;
+};
+
+static int runcmp(const int a, const int b)
+// compares rows a and b (0-based) as forder orders them; 0 when they are in the same group
+{
+  for (int j=0; j<nruncol; j++) {
+    const runcol *c = runcols+j;
+    int ga=0, gb=0;           // 2 for NA, 1 for NaN, 0 for a value
+    uint64_t va=0, vb=0;
+    switch(c->type) {
+    case RUN_INT: {
+      const int x=((const int *)c->x)[a], y=((const int *)c->x)[b];
+      if (x==y) continue;
+      ga = x==NA_INTEGER ? 2 : 0;  va = (uint32_t)x ^ 0x80000000u;
+      gb = y==NA_INTEGER ? 2 : 0;  vb = (uint32_t)y ^ 0x80000000u;
+    } break;
+    case RUN_I64: {
+      const int64_t x=((const int64_t *)c->x)[a], y=((const int64_t *)c->x)[b];
+      if (x==y) continue;
+      ga = x==INT64_MIN ? 2 : 0;  va = (uint64_t)x ^ 0x8000000000000000u;
+      gb = y==INT64_MIN ? 2 : 0;  vb = (uint64_t)y ^ 0x8000000000000000u;
+    } break;
+    case RUN_DBL: {
+      const double x=((const double *)c->x)[a], y=((const double *)c->x)[b];
+      ga = ISNAN(x) ? (ISNA(x) ? 2 : 1) : 0;  if (!ga) va = dtwiddle(x);
+      gb = ISNAN(y) ? (ISNA(y) ? 2 : 1) : 0;  if (!gb) vb = dtwiddle(y);
+    } break;
+    case RUN_STR: {
+      const SEXP x=((const SEXP *)c->x)[a], y=((const SEXP *)c->x)[b];
+      if (x==y) continue;
+      ga = x==NA_STRING ? 2 : 0;
+      gb = y==NA_STRING ? 2 : 0;
+      if (!ga && !gb) {
+        const int r = strcmp(CHAR(x), CHAR(y));  // all UTF-8 or ASCII, checked by the caller
+        if (r) return r<0 ? -c->asc : c->asc;
+        continue;
+      }
+    } break;
+    }
+    // NA and NaN are first (or last, with na.last=TRUE) in both ascending and descending order, as WRITE_KEY places them
+    if (ga!=gb) return (ga<gb) == (nalast==1) ? -1 : 1;
+    if (va!=vb) return va<vb ? -c->asc : c->asc;
+  }
+  return 0;
+}
+
+static void mergeRuns(int *x, int *tmp, const int a, const int b, const int c)
+// merges the sorted runs x[a..b) and x[b..c) of 1-based row numbers, stably; tmp[a..b) is used as working memory
+{
+  if (runcmp(x[b-1]-1, x[b]-1) <= 0) return;
+  // the rows at the start of the left run that are not after the first row of the right run are already in place, and so
+  // are the rows at the end of the right run that are not before the last row of the left run
+  int lo=a, hi=b;
+  while (lo<hi) { const int mid=lo+(hi-lo)/2; if (runcmp(x[mid]-1, x[b]-1) <= 0) lo=mid+1; else hi=mid; }
+  const int p = lo;
+  lo=b; hi=c;
+  while (lo<hi) { const int mid=lo+(hi-lo)/2; if (runcmp(x[mid]-1, x[b-1]-1) < 0) lo=mid+1; else hi=mid; }
+  const int q = lo;
+  memcpy(tmp+p, x+p, (b-p)*sizeof(int));
+  int i=p, j=b, w=p;
+  while (i<b && j<q) x[w++] = runcmp(x[j]-1, tmp[i]-1) < 0 ? x[j++] : tmp[i++];
+  while (i<b) x[w++] = tmp[i++];
+}
+
+static SEXP sortedRuns(SEXP DT, SEXP by, SEXP ascArg, SEXP ans, const bool verbose)
+// returns the result of forder when the input is sorted or nearly sorted, otherwise R_NilValue to continue with the radix sort
+{
+  if (sortType==0 || nalast==-1 || nrow<2) return R_NilValue;  // appearance order of groups, and removing NA, are left to the radix sort
+  double tt = wallclock();
+  const int ncol = LENGTH(by);
+  bool anystr = false;
+  runcols = (runcol *)malloc(ncol*sizeof(runcol));
+  if (!runcols) return R_NilValue;  // # nocov
+  nruncol = ncol;
+  for (int j=0; j<ncol; j++) {
+    SEXP x = VECTOR_ELT(DT, INTEGER(by)[j]-1);
+    runcols[j].asc = INTEGER(ascArg)[j];
+    runcols[j].x = DATAPTR_RO(x);
+    if (runcols[j].asc!=1 && runcols[j].asc!=-1) { free(runcols); runcols=NULL; return R_NilValue; }  // the radix sort reports it
+    switch(TYPEOF(x)) {
+    case INTSXP : case LGLSXP : runcols[j].type = RUN_INT; break;
+    case REALSXP : runcols[j].type = INHERITS(x, char_integer64) ? RUN_I64 : RUN_DBL; break;
+    case STRSXP : runcols[j].type = RUN_STR; anystr=true; break;
+    default : free(runcols); runcols=NULL; return R_NilValue;  // complex is left to the radix sort
+    }
+  }
+  // 1. the rows which sort before the row before them start a new run. Each thread takes a contiguous part of the rows.
+  const int nth = getDTthreads(nrow, true);
+  const int nblock = nth, blocksize = (nrow-1)/nblock + 1;
+  int *starts = (int *)malloc((size_t)nblock*MAX_RUNS*sizeof(int));
+  int *nstart = (int *)calloc(nblock, sizeof(int));
+  if (!starts || !nstart) { free(starts); free(nstart); free(runcols); runcols=NULL; return R_NilValue; }  // # nocov
+  bool many = false;  // too many runs, or strings which would need to be translated to UTF-8 to compare them
+  #pragma omp parallel for num_threads(nth)
+  for (int b=0; b<nblock; b++) {
+    const int from=b*blocksize, to=MIN(from+blocksize, nrow);
+    int *mystarts = starts + b*MAX_RUNS, k=0;
+    for (int i=from; i<to; i++) {
+      if (many) break;  // another thread found too many; naked read is fine, as in the sorted check at the end of forder
+      if (anystr) {
+        bool need = false;
+        for (int j=0; j<ncol; j++) if (runcols[j].type==RUN_STR) {
+          SEXP s = ((const SEXP *)runcols[j].x)[i];
+          if (s!=NA_STRING && NEED2UTF8(s)) need=true;
+        }
+        if (need) { many=true; break; }
+      }
+      if (i==0 || runcmp(i-1, i)<=0) continue;
+      if (k==MAX_RUNS) { many=true; break; }
+      mystarts[k++] = i;
+    }
+    nstart[b] = k;
+  }
+  int nrun = 1;
+  for (int b=0; b<nblock; b++) nrun += nstart[b];
+  if (many || nrun>MAX_RUNS) {
+    if (verbose) Rprintf(_("forder: input is not sorted or nearly sorted (more than %d runs found, or strings to translate to UTF-8); using the radix sort. Took %.3fs\n"), MAX_RUNS, wallclock()-tt);
+    free(starts); free(nstart); free(runcols); runcols=NULL;
+    return R_NilValue;
+  }
+  // 2. merge the runs pairwise, the pairs in parallel, until one run remains
+  int *rstart = (int *)malloc((nrun+1)*sizeof(int));
+  int *tmp = nrun>1 ? (int *)malloc(nrow*sizeof(int)) : NULL;
+  if (!rstart || (nrun>1 && !tmp)) { free(rstart); free(tmp); free(starts); free(nstart); free(runcols); runcols=NULL; return R_NilValue; }  // # nocov
+  rstart[0] = 0;
+  for (int b=0, r=1; b<nblock; b++) for (int k=0; k<nstart[b]; k++) rstart[r++] = starts[b*MAX_RUNS+k];
+  rstart[nrun] = nrow;
+  free(starts); free(nstart);
+  const int nrun0 = nrun;
+  while (nrun>1) {
+    const int npair = nrun/2;
+    #pragma omp parallel for schedule(dynamic) num_threads(MIN(nth, npair))
+    for (int p=0; p<npair; p++) mergeRuns(anso, tmp, rstart[2*p], rstart[2*p+1], rstart[2*p+2]);
+    int k=0;
+    for (int r=0; r<nrun; r+=2) rstart[k++] = rstart[r];
+    rstart[k] = nrow;
+    nrun = k;
+  }
+  free(rstart); free(tmp);
+  // 3. the groups, each starting where a row differs from the one before it in the sorted order
+  int nprotect = 0;
+  if (nrun0==1) { ans = PROTECT(allocVector(INTSXP, 0)); nprotect++; }  // already sorted
+  if (retgrp) {
+    int ngrp[nblock];
+    #pragma omp parallel for num_threads(nth)
+    for (int b=0; b<nblock; b++) {
+      const int from=b*blocksize, to=MIN(from+blocksize, nrow);
+      int k=0;
+      for (int i=from; i<to; i++) k += (i==0 || runcmp(anso[i-1]-1, anso[i]-1)!=0);
+      ngrp[b] = k;
+    }
+    int total=0;
+    for (int b=0; b<nblock; b++) { const int k=ngrp[b]; ngrp[b]=total; total+=k; }
+    SEXP ss = allocVector(INTSXP, total);
+    setAttrib(ans, sym_starts, ss);
+    int *ssd = INTEGER(ss);
+    #pragma omp parallel for num_threads(nth)
+    for (int b=0; b<nblock; b++) {
+      const int from=b*blocksize, to=MIN(from+blocksize, nrow);
+      int w = ngrp[b];
+      for (int i=from; i<to; i++) if (i==0 || runcmp(anso[i-1]-1, anso[i]-1)!=0) ssd[w++] = i+1;
+    }
+    int maxgrpn = 0;
+    for (int g=0; g<total; g++) {
+      const int n = (g==total-1 ? nrow+1 : ssd[g+1]) - ssd[g];
+      if (n>maxgrpn) maxgrpn=n;
+    }
+    setAttrib(ans, sym_maxgrpn, ScalarInteger(maxgrpn));
+  }
+  free(runcols); runcols=NULL;
+  if (verbose) {
+    if (nrun0==1) Rprintf(_("forder: input is already sorted; found in %.3fs\n"), wallclock()-tt);
+    else Rprintf(_("forder: input is %d sorted runs; merged them rather than using the radix sort in %.3fs\n"), nrun0, wallclock()-tt);
+  }
+  UNPROTECT(nprotect);
+  return ans;
+}
+
 void radix_r(const int from, const int to, const int radix);
 
 SEXP forder(SEXP DT, SEXP by, SEXP retGrpArg, SEXP sortGroupsArg, SEXP ascArg, SEXP naArg)
@@ -486,6 +846,12 @@ SEXP forder(SEXP DT, SEXP by, SEXP retGrpArg, SEXP sortGroupsArg, SEXP ascArg, S
   #pragma omp parallel for num_threads(getDTthreads(nrow, true))
   for (int i=0; i<nrow; i++) anso[i]=i+1;   // gdb 8.1.0.20180409-git very slow here, oddly
   TEND(1)
+  SEXP runans = sortedRuns(DT, by, ascArg, ans, verbose);
+  if (!isNull(runans)) {
+    cleanup();
+    UNPROTECT(n_protect);
+    return runans;
+  }
   savetl_init();   // from now on use Error not error
 
   int ncol=length(by);
@@ -24,6 +24,10 @@
   #include <math.h>      // ceil, sqrt, isfinite
 #endif
 #include <stdbool.h>
+#include <float.h>     // LDBL_MANT_DIG
+#ifndef NOZLIB
+#include <zlib.h>      // inflate for gzip input
+#endif
 #include "fread.h"
 #include "freadLookups.h"
 
@@ -61,9 +65,13 @@ static double NA_FLOAT64;  // takes fread.h:NA_FLOAT64_VALUE
 // Private globals so they can be cleaned up both on error and on successful return
 static void *mmp = NULL;
 static void *mmp_copy = NULL;
+static FILE *inflateOut = NULL;  // temporary file that gzip input too large for RAM is decompressed to
 static size_t fileSize;
 static int8_t *type = NULL, *tmpType = NULL, *size = NULL;
 static lenOff *colNames = NULL;
+static const char **jumpStart = NULL;  // where each jump started, recorded while reading for a reread to reuse; see [11]
+typedef struct FilterCol { int8_t type; int8_t size; int32_t off; } FilterCol;
+static FilterCol *filterCol = NULL;    // type and byte offset within its buffer's row of each args.filter column; see [11]
 static freadMainArgs args = {0};  // global for use by DTPRINT; static implies ={0} but include the ={0} anyway just in case for valgrind #4639
 
 const char typeName[NUMTYPE][10] = {"drop", "bool8", "bool8", "bool8", "bool8", "bool8", "int32", "int64", "float64", "float64", "float64", "int32", "float64", "string"};
@@ -121,20 +129,8 @@ static char* _const_cast(const char *ptr) {
   return tmp.b;
 }
 
-/**
- * Free any resources / memory buffers allocated by the fread() function, and
- * bring all global variables to a "clean slate". This function should always be
- * executed when fread() exits, either successfully or not. But if it doesn't
- * for some reason (e.g. unexpected error/bug) then it is called again on starting
- * with verbose message if it needed to clean anything up.
- */
-bool freadCleanup(void)
+static void unmapFile(void)
 {
-  bool neededCleanup = (type || tmpType || size || colNames || mmp || mmp_copy);
-  free(type); type = NULL;
-  free(tmpType); tmpType = NULL;
-  free(size); size = NULL;
-  free(colNames); colNames = NULL;
   if (mmp != NULL) {
     // Important to unmap as OS keeps internal reference open on file. Process is not exiting as
     // we're a .so/.dll here. If this was a process exiting we wouldn't need to unmap.
@@ -152,7 +148,54 @@ bool freadCleanup(void)
     #endif
     mmp = NULL;
   }
+}
+
+const char *inputBase(void)
+{
+  return mmp_copy ? (const char *)mmp_copy : (const char *)mmp;
+}
+
+void detachInput(void **addr, size_t *size, bool *mapped)
+{
+  // after copyFile() the data is in mmp_copy and the mapping can go as usual
+  *mapped = mmp_copy==NULL;
+  *addr = *mapped ? mmp : mmp_copy;
+  *size = fileSize;
+  if (*mapped) mmp = NULL; else mmp_copy = NULL;
+}
+
+void releaseInput(void *addr, size_t size, bool mapped)
+{
+  if (!mapped) { free(addr); return; }
+  // as unmapFile(); no STOP() here as this is called by a finalizer
+  #ifdef WIN32
+    if (!UnmapViewOfFile(addr))
+      DTPRINT(_("System error %d unmapping view of file\n"), GetLastError());      // # nocov
+  #else
+    if (munmap(addr, size))
+      DTPRINT(_("System errno %d unmapping file: %s\n"), errno, strerror(errno));  // # nocov
+  #endif
+}
+
+/**
+ * Free any resources / memory buffers allocated by the fread() function, and
+ * bring all global variables to a "clean slate". This function should always be
+ * executed when fread() exits, either successfully or not. But if it doesn't
+ * for some reason (e.g. unexpected error/bug) then it is called again on starting
+ * with verbose message if it needed to clean anything up.
+ */
+bool freadCleanup(void)
+{
+  bool neededCleanup = (type || tmpType || size || colNames || jumpStart || filterCol || mmp || mmp_copy || inflateOut);
+  free(type); type = NULL;
+  free(tmpType); tmpType = NULL;
+  free(size); size = NULL;
+  free(colNames); colNames = NULL;
+  free(jumpStart); jumpStart = NULL;
+  free(filterCol); filterCol = NULL;
+  unmapFile();
   free(mmp_copy); mmp_copy = NULL;
+  if (inflateOut) { fclose(inflateOut); inflateOut = NULL; }
   fileSize = 0;
   sep = whiteChar = quote = dec = '\0';
   quoteRule = -1;
@@ -277,6 +320,65 @@ static inline bool end_of_field(const char *ch) {
 }
 
 
+/**
+ * Structural scanning 8 bytes at a time (SWAR: SIMD within a register) using plain uint64_t arithmetic, so it is the
+ * same on every platform and compiler with no CPU feature detection needed. These only fast-forward over bytes that
+ * certainly cannot matter; the byte-at-a-time loops that follow them still decide exactly where a field or line ends.
+ * They never move to eof or beyond, so callers' `*++ch || ch<eof` loops remain bounded.
+ */
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+
+static inline uint64_t swar_load(const char *ch) {
+  uint64_t x;
+  memcpy(&x, ch, 8);  // unaligned load; compiles to a single instruction
+  return x;
+}
+
+static inline uint64_t swar_has_byte(uint64_t x, char c) {
+  x ^= SWAR_ONES * (uint8_t)c;  // zero byte where x==c
+  return (x - SWAR_ONES) & ~x & SWAR_HIGHS;
+}
+
+static inline uint64_t swar_has_ctrl(uint64_t x) {
+  // any byte <= 13; i.e. \0, \n, \r and the very rare other control characters
+  return (x - SWAR_ONES*14) & ~x & SWAR_HIGHS;
+}
+
+static inline int swar_count_byte(uint64_t x, char c) {
+  // exact count (swar_has_byte can flag a 0x01 byte after a match too, which is fine for has but not for count)
+  x ^= SWAR_ONES * (uint8_t)c;
+  uint64_t z = ~(((x & ~SWAR_HIGHS) + ~SWAR_HIGHS) | x) & SWAR_HIGHS;  // high bit of each zero byte
+  return (int)(((z >> 7) * SWAR_ONES) >> 56);
+}
+
+// to the first 8-byte word which could end an unquoted field: sep, \r, \n or \0
+static inline const char *swar_skip_field(const char *ch) {
+  while (ch+8<eof) {
+    uint64_t x = swar_load(ch);
+    if (swar_has_byte(x, sep) | swar_has_ctrl(x)) break;
+    ch += 8;
+  }
+  return ch;
+}
+
+// to the first 8-byte word which could contain a line ending
+static inline const char *swar_skip_line(const char *ch) {
+  while (ch+8<eof && !swar_has_ctrl(swar_load(ch))) ch += 8;
+  return ch;
+}
+
+// to the first 8-byte word containing c1 or c2; for quoted fields where sep and eol do not matter
+static inline const char *swar_skip_to(const char *ch, char c1, char c2) {
+  while (ch+8<eof) {
+    uint64_t x = swar_load(ch);
+    if (swar_has_byte(x, c1) | swar_has_byte(x, c2)) break;
+    ch += 8;
+  }
+  return ch;
+}
+
+
 static inline const char *end_NA_string(const char *start) {
   // start should be at the beginning of any potential NA string, after leading whitespace skipped by caller
   const char* const* nastr = NAstrings;
@@ -349,6 +451,7 @@ static inline const char *nextGoodLine(const char *ch, int ncol)
   // If this doesn't return the true line start, no matter. The previous thread will run-on and
   // resolve it. A good guess is all we need here. Being wrong will just be a bit slower.
   // If there are no embedded newlines, all newlines are true, and this guess will never be wrong.
+  ch = swar_skip_line(ch);
   while (*ch!='\n' && *ch!='\r' && (*ch!='\0' || ch<eof)) ch++;
   if (ch==eof) return eof;
   if (eol(&ch)) // move to last byte of the line ending sequence (e.g. \r\r\n would be +2).
@@ -360,6 +463,7 @@ static inline const char *nextGoodLine(const char *ch, int ncol)
   while (attempts++<5 && ch<eof) {
     const char *ch2 = ch;
     if (countfields(&ch2)==ncol) return ch;  // returns simpleNext here on first attempt, almost all the time
+    ch = swar_skip_line(ch);
     while (*ch!='\n' && *ch!='\r' && (*ch!='\0' || ch<eof)) ch++;
     if (eol(&ch)) ch++;
   }
@@ -442,6 +546,188 @@ void copyFile(size_t fileSize, const char *msg, bool verbose)  // only called in
   if (verbose) DTPRINT(_("  File copy in RAM took %.3f seconds.\n"), tt);
 }
 
+static void mapFile(const char *fnam, bool verbose)
+// memory map the file at mmp and set fileSize and sof
+{
+  #ifndef WIN32
+    int fd = open(fnam, O_RDONLY);
+    if (fd==-1) STOP(_("File not found: %s"),fnam);
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) == -1) {
+      close(fd);                                                     // # nocov
+      STOP(_("Opened file ok but couldn't obtain its size: %s"), fnam); // # nocov
+    }
+    fileSize = (size_t) stat_buf.st_size;
+    if (fileSize == 0) {close(fd); STOP(_("File is empty: %s"), fnam);}
+    if (verbose) DTPRINT(_("  File opened, size = %s.\n"), filesize_to_str(fileSize));
+
+    // No MAP_POPULATE for faster nrows=10 and to make possible earlier progress bar in row count stage
+    // Mac doesn't appear to support MAP_POPULATE anyway (failed on CRAN when I tried).
+    // TO DO?: MAP_HUGETLB for Linux but seems to need admin to setup first. My Hugepagesize is 2MB (>>2KB, so promising)
+    //         https://www.kernel.org/doc/Documentation/vm/hugetlbpage.txt
+    mmp = mmap(NULL, fileSize, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);  // COW for last page lastEOLreplaced
+    close(fd);  // we don't need to keep file handle open
+    if (mmp == MAP_FAILED) {
+  #else
+    // Following: http://msdn.microsoft.com/en-gb/library/windows/desktop/aa366548(v=vs.85).aspx
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    int attempts = 0;
+    while(hFile==INVALID_HANDLE_VALUE && attempts<5) {
+      hFile = CreateFile(fnam, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+      // FILE_SHARE_WRITE is required otherwise if the file is open in Excel, CreateFile fails. Should be ok now.
+      if (hFile==INVALID_HANDLE_VALUE) {
+        if (GetLastError()==ERROR_FILE_NOT_FOUND) STOP(_("File not found: %s"),fnam);
+        if (attempts<4) Sleep(250);  // 250ms
+      }
+      attempts++;
+      // Looped retry to avoid ephemeral locks by system utilities as recommended here : http://support.microsoft.com/kb/316609
+    }
+    if (hFile==INVALID_HANDLE_VALUE) STOP(_("Unable to open file after %d attempts (error %d): %s"), attempts, GetLastError(), fnam);
+    LARGE_INTEGER liFileSize;
+    if (GetFileSizeEx(hFile,&liFileSize)==0) { CloseHandle(hFile); STOP(_("GetFileSizeEx failed (returned 0) on file: %s"), fnam); }
+    fileSize = (size_t)liFileSize.QuadPart;
+    if (fileSize<=0) { CloseHandle(hFile); STOP(_("File is empty: %s"), fnam); }
+    if (verbose) DTPRINT(_("  File opened, size = %s.\n"), filesize_to_str(fileSize));
+    HANDLE hMap=CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (hMap==NULL) { CloseHandle(hFile); STOP(_("This is Windows, CreateFileMapping returned error %d for file %s"), GetLastError(), fnam); }
+    mmp = MapViewOfFile(hMap,FILE_MAP_COPY,0,0,fileSize);  // fileSize must be <= hilo passed to CreateFileMapping above.
+    CloseHandle(hMap);  // we don't need to keep the file open; the MapView keeps an internal reference;
+    CloseHandle(hFile); //   see https://msdn.microsoft.com/en-us/library/windows/desktop/aa366537(v=vs.85).aspx
+    if (mmp == NULL) {
+  #endif
+    int nbit = 8*sizeof(char *); // #nocov
+    STOP(_("Opened %s file ok but could not memory map it. This is a %dbit process. %s."), filesize_to_str(fileSize), nbit, // # nocov
+         nbit<=32 ? _("Please upgrade to 64bit") : _("There is probably not enough contiguous virtual memory available")); // # nocov
+  }
+  sof = (const char*) mmp;
+  if (verbose) DTPRINT(_("  Memory mapped ok\n"));
+}
+
+#ifndef NOZLIB
+static size_t physicalRAM(void)
+{
+  #ifdef WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? (size_t)status.ullTotalPhys : SIZE_MAX;
+  #else
+    const long pages = sysconf(_SC_PHYS_PAGES), pagesize = sysconf(_SC_PAGESIZE);
+    return (pages>0 && pagesize>0) ? (size_t)pages*(size_t)pagesize : SIZE_MAX;
+  #endif
+}
+
+#define INFLATE_WINDOW (64<<20)
+
+/**
+ * Inflate gzip input (already memory mapped at mmp) into a malloc'd buffer held by mmp_copy, and unmap
+ * the compressed file. Avoids decompressing to a temporary file on disk first. Concatenated gzip
+ * members (e.g. `cat a.gz b.gz`, bgzip or pigz --independent output) are all read. Deflate streams cannot
+ * be split, so the inflate itself is single threaded; the parallel parse then proceeds on the buffer as usual.
+ * When the output would not fit in half the physical RAM, or an allocation for it fails, what has been inflated
+ * so far is written to tmpFile and the rest follows through a fixed window of INFLATE_WINDOW bytes; tmpFile is
+ * then memory mapped in place of the gzip file, as if it had been decompressed to tmpdir up front.
+ */
+static void inflateFile(const char *fnam, const char *tmpFile, bool verbose)
+{
+  double tt = wallclock();
+  const unsigned char *in = (const unsigned char *)mmp;
+  const size_t ramLimit = physicalRAM()/2;
+  // The gzip trailer stores the uncompressed size modulo 2^32 of the last member. Use it as the initial
+  // capacity when it looks plausible; otherwise guess and grow. +1 for the final \0 that fread relies on.
+  size_t cap = (size_t)in[fileSize-4] | (size_t)in[fileSize-3]<<8 | (size_t)in[fileSize-2]<<16 | (size_t)in[fileSize-1]<<24;
+  if (cap < fileSize || cap/1032 > fileSize) cap = fileSize*4;  // 1032:1 is deflate's maximum compression ratio
+  cap = (cap < ramLimit ? cap : ramLimit) + 1;
+  char *out = (char *)malloc(cap);
+  if (!out) out = (char *)malloc(cap = INFLATE_WINDOW+1);  // go straight to tmpFile below
+  if (!out) STOP(_("Unable to allocate %s of contiguous virtual RAM to decompress gzip file: %s"), filesize_to_str(cap), fnam); // # nocov
+  mmp_copy = out;  // from now on owned by freadCleanup() in case of STOP
+  z_stream strm = {0};
+  if (inflateInit2(&strm, 15+32) != Z_OK)  // 15+32: max window and automatic gzip/zlib header detection
+    STOP(_("Unable to initialize zlib to decompress gzip file: %s"), fnam); // # nocov
+  size_t inPos=0, outPos=0, written=0;  // written: bytes already in tmpFile, before out[0]
+  int ret = Z_OK;
+  while (true) {
+    if (outPos+1 >= cap) {
+      const size_t newcap = cap + cap/2;
+      char *tmp = (inflateOut || newcap>ramLimit) ? NULL : (char *)realloc(out, newcap);
+      if (tmp) {
+        mmp_copy = out = tmp;
+        cap = newcap;
+      } else {
+        if (!inflateOut) {
+          if (!tmpFile || !*tmpFile) {
+            // # nocov start
+            inflateEnd(&strm);
+            STOP(_("Unable to reallocate %s of contiguous virtual RAM to decompress gzip file: %s"), filesize_to_str(newcap), fnam);
+            // # nocov end
+          }
+          inflateOut = fopen(tmpFile, "wb");
+          if (!inflateOut) {
+            inflateEnd(&strm);                                                                                           // # nocov
+            STOP(_("Unable to create temporary file to decompress gzip file %s into: %s"), fnam, strerror(errno));      // # nocov
+          }
+          if (verbose) DTPRINT(_("  Decompressed output of gzip file does not fit in RAM, continuing in temporary file %s\n"), tmpFile);
+        }
+        if (fwrite(out, 1, outPos, inflateOut) != outPos) {
+          inflateEnd(&strm);                                                                                             // # nocov
+          STOP(_("Failed to write to temporary file %s when decompressing gzip file %s: %s"), tmpFile, fnam, strerror(errno)); // # nocov
+        }
+        written += outPos;
+        outPos = 0;
+        if (cap > INFLATE_WINDOW+1) {  // swap the large buffer for a window
+          free(out);
+          mmp_copy = out = (char *)malloc(cap = INFLATE_WINDOW+1);
+          if (!out) { inflateEnd(&strm); STOP(_("Unable to allocate %s of contiguous virtual RAM to decompress gzip file: %s"), filesize_to_str(cap), fnam); } // # nocov
+        }
+      }
+    }
+    // avail_in and avail_out are 32bit so feed files > 4GB in pieces
+    size_t inLeft = fileSize-inPos, outLeft = cap-1-outPos;
+    strm.next_in = (Bytef *)(in+inPos);
+    strm.avail_in = (uInt)(inLeft > UINT32_MAX ? UINT32_MAX : inLeft);
+    strm.next_out = (Bytef *)(out+outPos);
+    strm.avail_out = (uInt)(outLeft > UINT32_MAX ? UINT32_MAX : outLeft);
+    uInt availIn=strm.avail_in, availOut=strm.avail_out;
+    ret = inflate(&strm, Z_NO_FLUSH);
+    inPos += availIn-strm.avail_in;
+    outPos += availOut-strm.avail_out;
+    if (ret==Z_STREAM_END) {
+      // skip any zero padding after a member, then continue with the next member if there is one
+      while (inPos<fileSize && in[inPos]=='\0') inPos++;
+      if (inPos==fileSize) break;
+      ret = inflateReset(&strm);
+    } else if (ret==Z_BUF_ERROR && inPos==fileSize) {
+      ret = Z_DATA_ERROR;  // input exhausted before the end of the deflate stream
+    }
+    if (ret!=Z_OK && ret!=Z_BUF_ERROR) {
+      const char *zmsg = strm.msg ? strm.msg : _("truncated file");
+      inflateEnd(&strm);
+      STOP(_("Failed to decompress gzip file after %s of output (zlib error %d: %s). The file may be truncated or corrupt: %s"),
+           filesize_to_str(written+outPos), ret, zmsg, fnam);
+    }
+  }
+  inflateEnd(&strm);
+  unmapFile();   // the compressed mapping; fileSize must still be its size here
+  if (verbose) DTPRINT(_("  Decompressed gzip file from %s "), filesize_to_str(fileSize));  // two calls as filesize_to_str uses a static buffer
+  if (verbose) DTPRINT(_("to %s in %.3f seconds. %s\n"), filesize_to_str(written+outPos), wallclock()-tt,
+                       inflateOut ? _("Memory mapping the temporary file.") : _("No temporary file used."));
+  if (written+outPos==0) STOP(_("File is empty: %s"), fnam);
+  if (inflateOut) {
+    const bool ok = fwrite(out, 1, outPos, inflateOut)==outPos;
+    const int err = errno;
+    const bool closed = fclose(inflateOut)==0;
+    inflateOut = NULL;
+    free(mmp_copy); mmp_copy = NULL;
+    if (!ok || !closed) STOP(_("Failed to write to temporary file %s when decompressing gzip file %s: %s"), tmpFile, fnam, strerror(ok ? errno : err)); // # nocov
+    mapFile(tmpFile, verbose);
+    return;
+  }
+  fileSize = outPos;
+  sof = mmp_copy;
+  eof = (char *)mmp_copy + fileSize;  // cap is at least fileSize+1 so writing \0 at eof is fine
+}
+#endif
+
 
 //==============================================================================
 // Field parsers
@@ -496,6 +782,7 @@ static void Field(FieldParseContext *ctx)
   const char *fieldStart=ch;
   if (*ch!=quote || quoteRule==3 || quote=='\0') {
     // Most common case. Unambiguously not quoted. Simply search for sep|eol. If field contains sep|eol then it should have been quoted and we do not try to heal that.
+    ch = swar_skip_field(ch);
     while(!end_of_field(ch)) ch++;  // sep, \r, \n or eof will end
     *(ctx->ch) = ch;
     int fieldLen = (int)(ch-fieldStart);
@@ -520,12 +807,14 @@ static void Field(FieldParseContext *ctx)
         if (ch[1]==quote) { ch++; continue; }
         break;  // found undoubled closing quote
       }
+      ch = swar_skip_to(ch+1, quote, quote) - 1;  // -1 as the loop increments first
     }
     break;
   case 1:  // quoted with embedded quotes escaped; the final unescaped " must be followed by sep|eol
     while (*++ch || ch<eof) {
       if (*ch=='\\' && (ch[1]==quote || ch[1]=='\\')) { ch++; continue; }
       if (*ch==quote) break;
+      ch = swar_skip_to(ch+1, quote, '\\') - 1;
     }
     break;
   case 2:
@@ -572,6 +861,81 @@ static void Field(FieldParseContext *ctx)
   }
 }
 
+/**
+ * CT_DROP: move to the end of the field exactly as Field() would, but without the work needed to store it; i.e. no
+ * whitespace trimming and no NA string matching. Quoted fields are rare enough to leave to Field().
+ */
+static void SkipField(FieldParseContext *ctx)
+{
+  const char *ch = *(ctx->ch);
+  if ((*ch==' ' && stripWhite) || (*ch=='\0' && ch<eof))
+    while(*++ch==' ' || (*ch=='\0' && ch<eof));
+  if (*ch==quote && quoteRule!=3 && quote!='\0') { Field(ctx); return; }
+  ch = swar_skip_field(ch);
+  while(!end_of_field(ch)) ch++;
+  *(ctx->ch) = ch;
+}
+
+/**
+ * Skip the last nfield fields of a line when none of them are stored; i.e. they are all dropped, or not being reread.
+ * ch is at the start of the first of them (just after a sep). Unquoted contents are skipped 8 bytes at a time while
+ * counting seps, rather than field by field. Returns the start of the next line, or NULL when the line does not have
+ * exactly nfield more fields or needs more care (eof, \0, a badly closed quoted field). The caller then goes field by
+ * field as usual, so the result (including any error or warning about the line) is the same either way.
+ * Not for sep==' ', whose repeated seps count as one.
+ */
+static const char *skip_tail(const char *ch, int nfield)
+{
+  if (quoteRule==2) return NULL;  // a field starting with a quote may contain sep
+  const char *tailStart = ch;
+  const bool quoted = quote!='\0' && quoteRule<2;  // otherwise quotes don't affect where fields and lines end
+  int nsep = 0;
+  while (true) {
+    while (ch+8<eof) {
+      uint64_t x = swar_load(ch);
+      // not swar_has_ctrl() so that sep='\t' is counted here too
+      if (swar_has_byte(x, '\n') | swar_has_byte(x, '\r') | swar_has_byte(x, '\0') | (quoted ? swar_has_byte(x, quote) : 0)) break;
+      nsep += swar_count_byte(x, sep);
+      ch += 8;
+    }
+    char c = *ch;
+    if (c==sep) { nsep++; ch++; continue; }
+    if (c=='\n' || c=='\r') {
+      if (eol(&ch)) return nsep+1==nfield ? ch+1 : NULL;
+      ch++;  // lone \r inside a field when \r is not a line ending
+      continue;
+    }
+    if (c=='\0') return NULL;  // eof or an embedded NUL which Field() skips in its own way
+    if (c==quote && quoted) {
+      // an opening quote only at the start of a field, after any spaces Field() would skip
+      const char *b = ch;
+      if (stripWhite) while (b>tailStart && b[-1]==' ') b--;
+      if (b==tailStart || b[-1]==sep) {
+        if (quoteRule==0) {
+          while (*++ch || ch<eof) {
+            if (*ch==quote) {
+              if (ch[1]==quote) { ch++; continue; }
+              break;
+            }
+          }
+        } else {
+          while (*++ch || ch<eof) {
+            if (*ch=='\\' && (ch[1]==quote || ch[1]=='\\')) { ch++; continue; }
+            if (*ch==quote) break;
+          }
+        }
+        if (ch>=eof) return NULL;
+        ch++;  // over closing quote
+        skip_white(&ch);
+        const char *e = ch;
+        if (*ch!=sep && !((*ch=='\n' || *ch=='\r') && eol(&e))) return NULL;  // junk after closing quote, or eof
+        continue;
+      }
+    }
+    ch++;
+  }
+}
+
 static void str_to_i32_core(const char **pch, int32_t *target)
 {
   const char *ch = *pch;
@@ -673,6 +1037,62 @@ cat("1.0E300L\n};\n", file=f, append=TRUE)
  * of precision, for example `1.2439827340958723094785103` will not be parsed
  * as a double.
  */
+static inline bool nearMidpoint(long double r, double d)
+{
+  // whether r, which rounded to d, is within a few of its own last place of halfway between d and d's neighbour
+  union { double d; uint64_t u; } b = { .d = d };
+  const int E = (b.u>>52) & 0x7FF;
+  if (E==0x7FF) return false;  // Inf
+  union { double d; uint64_t u; } ulp = { .u = E>52 ? (uint64_t)(E-52)<<52 : (E ? 1ULL<<(E-1) : 1) };  // 2^(E-1075), subnormal when E<=52
+  long double half = 0.5L*ulp.d;
+  if (r<d && (b.u & 0xFFFFFFFFFFFFF)==0 && E>1) half /= 2;  // d is a power of 2 so the gap below it is half the gap above
+  const long double diff = r<d ? d-r : r-d;
+  return fabsl(diff-half) <= half/256;
+}
+
+static inline void mul64(const uint64_t a, const uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+  // the full 128 bit product of a and b, in halves; without __int128 which is not ISO C
+  const uint64_t aL=(uint32_t)a, aH=a>>32, bL=(uint32_t)b, bH=b>>32;
+  const uint64_t ll=aL*bL, lh=aL*bH, hl=aH*bL, hh=aH*bH;
+  const uint64_t mid = (ll>>32) + (uint32_t)lh + (uint32_t)hl;
+  *hi = hh + (lh>>32) + (hl>>32) + (mid>>32);
+  *lo = (mid<<32) | (uint32_t)ll;
+}
+
+static inline bool eiselLemire(uint64_t w, const int q, double *d)
+{
+  // w*10^q (w>0) correctly rounded to double, from the leading 128 bits of 10^q in pow10mant128, as in Lemire (2021)
+  // "Number Parsing at a Gigabyte per Second". false when those bits can't decide the rounding (vanishingly rare for
+  // random input), or when the result would be subnormal, Inf or 0; then the caller falls back to a slower exact way.
+  if (q < -342 || q > 308) return false;
+  const uint64_t *t = pow10mant128[q+342];
+  int lz = 0;
+  for (int s=32; s; s>>=1) if (!(w >> (64-s))) { w <<= s; lz += s; }  // normalise so the top bit of w is set
+  uint64_t hi, lo;
+  mul64(w, t[0], &hi, &lo);
+  if ((hi & 0x1FF)==0x1FF && lo+w < w) {
+    // the low bits which decide the rounding may carry into hi, so take the next 64 bits of 10^q into account too
+    uint64_t hi2, lo2;
+    mul64(w, t[1], &hi2, &lo2);
+    const uint64_t mlo = lo + hi2;
+    if (mlo < lo) hi++;
+    if ((hi & 0x1FF)==0x1FF && mlo+1==0 && lo2+w < w) return false;
+    lo = mlo;
+  }
+  const int msb = (int)(hi>>63);
+  uint64_t m = hi >> (msb+9);  // 54 bits: the 53 of the double and one to round with
+  int exp2 = (int)((217706*(int64_t)q) >> 16) + 64 + 1023 - lz - (1^msb);  // 217706/2^16 is log2(10)
+  if (lo==0 && (hi & 0x1FF)==0 && (m & 3)==1) return false;  // exactly halfway as far as these bits show
+  m += m & 1;
+  m >>= 1;
+  if (m >> 53) { m >>= 1; exp2++; }  // rounded up to the next power of 2
+  if (exp2 < 1 || exp2 > 0x7FE) return false;
+  union { uint64_t u; double d; } b = { .u = (uint64_t)exp2<<52 | (m & 0xFFFFFFFFFFFFF) };
+  *d = b.d;
+  return true;
+}
+
 static void parse_double_regular_core(const char **pch, double *target)
 {
   #define FLOAT_MAX_DIGITS 18
@@ -772,22 +1192,42 @@ static void parse_double_regular_core(const char **pch, double *target)
   }
   if (e<-350 || e>350) goto fail;
 
-  long double r = (long double)acc;
-  if (e < -300 || e > 300) {
-    // Handle extra precision by pre-multiplying the result by pow(10, extra),
-    // and then remove extra from e.
-    // This avoids having to store very small or very large constants that may
-    // fail to be encoded by the compiler, even though the values can actually
-    // be stored correctly.
-    int_fast8_t extra = e < 0 ? e + 300 : e - 300;
-    r = extra<0 ? r/pow10lookup[-extra] : r*pow10lookup[extra];
-    e -= extra;
-  }
-
-  // pow10lookup[301] contains 10^(0:300). Storing negative powers there too
-  // avoids this ternary but is slightly less accurate in some cases, #4461
-  r = e < 0 ? r/pow10lookup[-e] : r*pow10lookup[e];
-  *target = (double)(neg? -r : r);
+  double d;
+  if (acc <= (1ULL<<53) && e >= -22 && e <= 22) {
+    // acc and 10^e are both exact in double so one division or multiplication rounds correctly (Clinger's fast path)
+    d = e < 0 ? (double)acc/(double)pow10lookup[-e] : (double)acc*(double)pow10lookup[e];
+  } else if (acc==0) {
+    d = 0.0;  // e.g. 0e100, or 0. followed by more than 22 zeros
+  } else if (!eiselLemire(acc, e, &d)) {
+    const int_fast32_t e10 = e;
+    long double r = (long double)acc;
+    if (e < -300 || e > 300) {
+      // Handle extra precision by pre-multiplying the result by pow(10, extra),
+      // and then remove extra from e.
+      // This avoids having to store very small or very large constants that may
+      // fail to be encoded by the compiler, even though the values can actually
+      // be stored correctly.
+      int_fast8_t extra = e < 0 ? e + 300 : e - 300;
+      r = extra<0 ? r/pow10lookup[-extra] : r*pow10lookup[extra];
+      e -= extra;
+    }
+
+    // pow10lookup[301] contains 10^(0:300). Storing negative powers there too
+    // avoids this ternary but is slightly less accurate in some cases, #4461
+    r = e < 0 ? r/pow10lookup[-e] : r*pow10lookup[e];
+    d = (double)r;
+    // Only reached for the few numbers eiselLemire() can't decide, and subnormals and overflow. r is within a unit or
+    // two of its last place of acc*10^e10, so rounding it to double only risks going the wrong way when r is that close
+    // to the midpoint between two doubles. Then (rarely) strtod rounds the exact value, so that the up to 17 significant
+    // digits written by fwrite(..., roundtrip=TRUE) read back as exactly the same double. Without a wider long double
+    // there is no way to tell, so then strtod is used for all of these few.
+    if (LDBL_MANT_DIG == DBL_MANT_DIG || nearMidpoint(r, d)) {
+      char exact[32];
+      snprintf(exact, 32, "%"PRIu64"e%d", (uint64_t)acc, (int)e10);
+      d = strtod(exact, NULL);
+    }
+  }
+  *target = neg ? -d : d;
   *pch = ch;
   return;
 
@@ -1158,7 +1598,7 @@ static void parse_bool_lowercase(FieldParseContext *ctx)
  */
 typedef void (*reader_fun_t)(FieldParseContext *ctx);
 static reader_fun_t fun[NUMTYPE] = {
-  (reader_fun_t) &Field,        // CT_DROP
+  (reader_fun_t) &SkipField,    // CT_DROP
   (reader_fun_t) &parse_empty,  // CT_EMPTY
   (reader_fun_t) &parse_bool_numeric,
   (reader_fun_t) &parse_bool_uppercase,
@@ -1237,6 +1677,85 @@ static int detect_types( const char **pch, int8_t type[], int ncol, bool *bumped
 }
 
 
+/**
+ * True if the row in the thread buffers at r8, r4 and r1 meets all the args.filter conditions. Strings are compared
+ * byte for byte with the values as they are in the file (after strip.white); NA never matches.
+ */
+static bool keepRow(const char *r8, const char *r4, const char *r1, const char *anchor)
+{
+  for (int f=0; f<args.nfilter; f++) {
+    const freadFilter *flt = args.filter + f;
+    const FilterCol *fc = filterCol + f;
+    if (fc->type == CT_STRING) {
+      lenOff lo;
+      memcpy(&lo, r8 + fc->off, sizeof(lenOff));
+      if (lo.len < 0) return false;  // NA
+      bool found = false;
+      for (int i=0; i<flt->n && !found; i++)
+        found = lo.len==flt->strLen[i] && memcmp(anchor + lo.off, flt->str[i], (size_t)lo.len)==0;
+      if (found != (flt->op != FILTER_NE)) return false;
+      continue;
+    }
+    double x;
+    if (fc->size == 8) {
+      if (fc->type == CT_INT64) {
+        int64_t v; memcpy(&v, r8 + fc->off, 8);
+        if (v == NA_INT64) return false;
+        x = (double)v;
+      } else {
+        memcpy(&x, r8 + fc->off, 8);
+        if (isnan(x)) return false;
+      }
+    } else if (fc->size == 4) {
+      int32_t v; memcpy(&v, r4 + fc->off, 4);
+      if (v == NA_INT32) return false;
+      x = v;
+    } else {
+      int8_t v = (int8_t)r1[fc->off];
+      if (v == NA_BOOL8) return false;
+      x = v;
+    }
+    const double *val = flt->num;
+    bool ok;
+    switch (flt->op) {
+    case FILTER_EQ: ok = x == val[0]; break;
+    case FILTER_NE: ok = x != val[0]; break;
+    case FILTER_LT: ok = x <  val[0]; break;
+    case FILTER_LE: ok = x <= val[0]; break;
+    case FILTER_GT: ok = x >  val[0]; break;
+    case FILTER_GE: ok = x >= val[0]; break;
+    default:
+      ok = false;
+      for (int i=0; i<flt->n && !ok; i++) ok = x == val[i];
+    }
+    if (!ok) return false;
+  }
+  return true;
+}
+
+/**
+ * Removes the rows not meeting args.filter from the first nrow rows of a thread's buffers, moving the kept rows up so
+ * they stay in file order. Returns the number of rows kept.
+ */
+static int64_t filterBuffer(ThreadLocalFreadParsingContext *ctx, int64_t nrow)
+{
+  char *b8 = (char *)ctx->buff8, *b4 = (char *)ctx->buff4, *b1 = (char *)ctx->buff1;
+  const size_t rs8 = ctx->rowSize8, rs4 = ctx->rowSize4, rs1 = ctx->rowSize1;
+  int64_t nkeep = 0;
+  for (int64_t i=0; i<nrow; i++) {
+    const char *r8 = b8 + i*rs8, *r4 = b4 + i*rs4, *r1 = b1 + i*rs1;
+    if (!keepRow(r8, r4, r1, ctx->anchor)) continue;
+    if (nkeep < i) {
+      memcpy(b8 + nkeep*rs8, r8, rs8);
+      memcpy(b4 + nkeep*rs4, r4, rs4);
+      memcpy(b1 + nkeep*rs1, r1, rs1);
+    }
+    nkeep++;
+  }
+  return nkeep;
+}
+
+
 //=================================================================================================
 //
 // Main fread() function that does all the job of reading a text/csv file.
@@ -1272,6 +1791,17 @@ int freadMain(freadMainArgs _args) {
   memcpy(&NA_FLOAT64, &ui64, 8);
 
   int64_t nrowLimit = args.nrowLimit;
+  int64_t chunkRows = args.chunkRows;
+  if (chunkRows<0 || (chunkRows>0 && nrowLimit<INT64_MAX))
+    STOP(_("Internal error: chunkRows=%"PRId64" and nrowLimit=%"PRId64". R level catches this."), (int64_t)chunkRows, (int64_t)nrowLimit); // # nocov
+  if (args.nfilter && nrowLimit<INT64_MAX)
+    STOP(_("Internal error: filter has %d conditions and nrowLimit=%"PRId64". R level catches this."), args.nfilter, (int64_t)nrowLimit); // # nocov
+  if (args.schema) {
+    if (args.schema->ncol<1 || args.schema->skip<0) STOP(_("Internal error: schema ncol=%d skip=%"PRId64". R level catches this."), args.schema->ncol, (int64_t)args.schema->skip); // # nocov
+    args.header = args.schema->header;
+    args.skipNrow = args.schema->skip;
+    args.skipString = NULL;
+  }
   NAstrings = args.NAstrings;
   if (NAstrings==NULL) STOP(_("Internal error: NAstrings is itself NULL. When empty it should be pointer to NULL.")); // # nocov
   any_number_like_NAstrings = false;
@@ -1322,6 +1852,9 @@ int freadMain(freadMainArgs _args) {
     if (args.skipNrow >= 0) DTPRINT(_("  skip num lines = %"PRId64"\n"), (int64_t)args.skipNrow);
     if (args.skipString) DTPRINT(_("  skip to string = <<%s>>\n"), args.skipString);
     DTPRINT(_("  show progress = %d\n"), args.showProgress);
+    if (chunkRows) DTPRINT(_("  chunk rows = %"PRId64"\n"), (int64_t)chunkRows);
+    if (args.schema) DTPRINT(_("  schema supplied for %d columns\n"), args.schema->ncol);
+    if (args.nfilter) DTPRINT(_("  filter = %d condition(s)\n"), args.nfilter);
     DTPRINT(_("  0/1 column will be read as %s\n"), args.logical01? "boolean" : "integer");
   }
 
@@ -1362,58 +1895,14 @@ int freadMain(freadMainArgs _args) {
   else if (args.filename) {
     if (verbose) DTPRINT(_("  Opening file %s\n"), args.filename);
     const char* fnam = args.filename;
-    #ifndef WIN32
-      int fd = open(fnam, O_RDONLY);
-      if (fd==-1) STOP(_("File not found: %s"),fnam);
-      struct stat stat_buf;
-      if (fstat(fd, &stat_buf) == -1) {
-        close(fd);                                                     // # nocov
-        STOP(_("Opened file ok but couldn't obtain its size: %s"), fnam); // # nocov
-      }
-      fileSize = (size_t) stat_buf.st_size;
-      if (fileSize == 0) {close(fd); STOP(_("File is empty: %s"), fnam);}
-      if (verbose) DTPRINT(_("  File opened, size = %s.\n"), filesize_to_str(fileSize));
-
-      // No MAP_POPULATE for faster nrows=10 and to make possible earlier progress bar in row count stage
-      // Mac doesn't appear to support MAP_POPULATE anyway (failed on CRAN when I tried).
-      // TO DO?: MAP_HUGETLB for Linux but seems to need admin to setup first. My Hugepagesize is 2MB (>>2KB, so promising)
-      //         https://www.kernel.org/doc/Documentation/vm/hugetlbpage.txt
-      mmp = mmap(NULL, fileSize, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);  // COW for last page lastEOLreplaced
-      close(fd);  // we don't need to keep file handle open
-      if (mmp == MAP_FAILED) {
+    mapFile(fnam, verbose);
+    if (fileSize>=18 && memcmp(sof, "\x1F\x8B", 2)==0) {  // 18 = 10 byte gzip header + 8 byte trailer
+    #ifndef NOZLIB
+      inflateFile(fnam, args.tmpFile, verbose);
     #else
-      // Following: http://msdn.microsoft.com/en-gb/library/windows/desktop/aa366548(v=vs.85).aspx
-      HANDLE hFile = INVALID_HANDLE_VALUE;
-      int attempts = 0;
-      while(hFile==INVALID_HANDLE_VALUE && attempts<5) {
-        hFile = CreateFile(fnam, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
-        // FILE_SHARE_WRITE is required otherwise if the file is open in Excel, CreateFile fails. Should be ok now.
-        if (hFile==INVALID_HANDLE_VALUE) {
-          if (GetLastError()==ERROR_FILE_NOT_FOUND) STOP(_("File not found: %s"),fnam);
-          if (attempts<4) Sleep(250);  // 250ms
-        }
-        attempts++;
-        // Looped retry to avoid ephemeral locks by system utilities as recommended here : http://support.microsoft.com/kb/316609
-      }
-      if (hFile==INVALID_HANDLE_VALUE) STOP(_("Unable to open file after %d attempts (error %d): %s"), attempts, GetLastError(), fnam);
-      LARGE_INTEGER liFileSize;
-      if (GetFileSizeEx(hFile,&liFileSize)==0) { CloseHandle(hFile); STOP(_("GetFileSizeEx failed (returned 0) on file: %s"), fnam); }
-      fileSize = (size_t)liFileSize.QuadPart;
-      if (fileSize<=0) { CloseHandle(hFile); STOP(_("File is empty: %s"), fnam); }
-      if (verbose) DTPRINT(_("  File opened, size = %s.\n"), filesize_to_str(fileSize));
-      HANDLE hMap=CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
-      if (hMap==NULL) { CloseHandle(hFile); STOP(_("This is Windows, CreateFileMapping returned error %d for file %s"), GetLastError(), fnam); }
-      mmp = MapViewOfFile(hMap,FILE_MAP_COPY,0,0,fileSize);  // fileSize must be <= hilo passed to CreateFileMapping above.
-      CloseHandle(hMap);  // we don't need to keep the file open; the MapView keeps an internal reference;
-      CloseHandle(hFile); //   see https://msdn.microsoft.com/en-us/library/windows/desktop/aa366537(v=vs.85).aspx
-      if (mmp == NULL) {
+      STOP(_("File appears to be gzip compressed but zlib header files were not found at the time data.table was compiled: %s"), fnam); // # nocov
     #endif
-      int nbit = 8*sizeof(char *); // #nocov
-      STOP(_("Opened %s file ok but could not memory map it. This is a %dbit process. %s."), filesize_to_str(fileSize), nbit, // # nocov
-           nbit<=32 ? _("Please upgrade to 64bit") : _("There is probably not enough contiguous virtual memory available")); // # nocov
     }
-    sof = (const char*) mmp;
-    if (verbose) DTPRINT(_("  Memory mapped ok\n"));
   } else {
     STOP(_("Internal error: Neither `input` nor `filename` are given, nothing to read.")); // # nocov
   }
@@ -1490,7 +1979,9 @@ int freadMain(freadMainArgs _args) {
     }
     if (!lastEOLreplaced) {
       // very unusual branch because properly formed csv will have final eol
-      if (fileSize%4096!=0) {
+      if (mmp_copy) {
+        if (verbose) DTPRINT(_("  File ends abruptly with '%c'. Final end-of-line is missing. Decompressed in RAM so writing 0 after the last byte.\n"), eof[-1]);
+      } else if (fileSize%4096!=0) {
         if (verbose) DTPRINT(_("  File ends abruptly with '%c'. Final end-of-line is missing. Using cow page to write 0 to the last byte.\n"), eof[-1]);
         // We could do this routinely (i.e. when there is a final newline too) but we desire to run all tests through the harder
         // branch above that replaces the final newline with \0 to test that logic (e.g. test 893 which causes a type bump in the last
@@ -1590,7 +2081,34 @@ int freadMain(freadMainArgs _args) {
   {
   if (verbose) DTPRINT(_("[06] Detect separator, quoting rule, and ncolumns\n"));
 
-  if (args.sep == '\n') {  // '\n' because '\0' is taken already to mean 'auto'
+  if (args.schema) {
+    const freadSchema *schema = args.schema;
+    sep = schema->sep;
+    whiteChar = (sep==' ' ? '\t' : (sep=='\t' ? ' ' : 0));
+    quoteRule = schema->quoteRule;
+    ncol = schema->ncol;
+    fill |= schema->fill;
+    if (verbose) {
+      DTPRINT(_("  Using the layout from schema=; detection skipped. "));
+      DTPRINT((unsigned)sep<32 ? "sep=%#02x" : "sep='%c'", sep);
+      DTPRINT(_(" with %d fields using quote rule %d\n"), ncol, quoteRule);
+    }
+    // Fail fast on a different layout: check jump 0 has ncol fields on every row rather than finding out part way through
+    // reading. The column names row may have one fewer, when the first column is row names. Column names are checked by
+    // userOverride().
+    int thisRow=0;
+    ch = pos;
+    while (ch<eof && thisRow++<jumpLines) {
+      const char *lineStart = ch;
+      int thisncol = countfields(&ch);
+      if (thisncol==0 && skipEmptyLines) continue;
+      if (thisncol!=ncol && !(fill && thisncol>=0 && thisncol<ncol) && !(thisRow==1 && schema->header && thisncol==ncol-1))
+        STOP(_("schema= is for %d columns but line %d has %d fields so this input does not have the same layout: <<%s>>. Remove schema= to detect its layout."),
+             ncol, row1line+thisRow-1, thisncol, strlim(lineStart, 500));
+    }
+    firstJumpEnd = ch;  // size of first 100 lines in bytes is used later for nrow estimate
+    ch = pos;
+  } else if (args.sep == '\n') {  // '\n' because '\0' is taken already to mean 'auto'
     // unusual
     if (verbose) DTPRINT(_("  sep='\\n' passed in meaning read lines as single character column\n"));
     sep = 127;     // ASCII DEL: a character different from \r, \n and \0 that isn't in the data
@@ -1749,7 +2267,7 @@ int freadMain(freadMainArgs _args) {
   if (ncol<1 || row1line<1) STOP(_("Internal error: ncol==%d line==%d after detecting sep, ncol and first line"), ncol, row1line); // # nocov
   int tt = countfields(&ch);
   ch = pos; // move back to start of line since countfields() moved to next
-  if (!fill && tt!=ncol) STOP(_("Internal error: first line has field count %d but expecting %d"), tt, ncol); // # nocov
+  if (!fill && tt!=ncol && !(args.schema && tt==ncol-1)) STOP(_("Internal error: first line has field count %d but expecting %d"), tt, ncol); // # nocov
   if (verbose) {
     DTPRINT(_("  Detected %d columns on line %d. This line is either column names or first data row. Line starts as: <<%s>>\n"),
             tt, row1line, strlim(pos, 30));
@@ -1759,7 +2277,7 @@ int freadMain(freadMainArgs _args) {
 
   if (ncol==1 && lastEOLreplaced && (eof[-1]=='\n' || eof[-1]=='\r')) {
     // Multiple newlines at the end are significant in the case of 1-column files only (multiple NA at the end)
-    if (fileSize%4096==0) {
+    if (fileSize%4096==0 && !mmp_copy) {
       const char *msg = _("This file is very unusual: it's one single column, ends with 2 or more end-of-line (representing several NA at the end), and is a multiple of 4096, too.");
       if (verbose) DTPRINT(_("  Copying file in RAM. %s\n"), msg);
       ASSERT(mmp_copy==NULL, "mmp has already been copied due to abrupt non-eol ending, so it does not end with 2 or more eol.", 1/*dummy arg for macro*/); // #nocov
@@ -1795,7 +2313,13 @@ int freadMain(freadMainArgs _args) {
 
   int8_t type0 = 1;
   while (disabled_parsers[type0]) type0++;
-  for (int j=0; j<ncol; j++) {
+  if (args.schema) {
+    // start from the types detected on the earlier file; jump 0 may still bump them and out-of-sample bumps are handled as usual
+    memcpy(type, args.schema->types, (size_t)ncol);
+    memcpy(tmpType, type, (size_t)ncol);
+    const char *ch1 = pos;
+    autoFirstColName = args.schema->header && countfields(&ch1)==ncol-1;
+  } else for (int j=0; j<ncol; j++) {
     // initialize with the lowest available type
     tmpType[j] = type[j] = type0;
   }
@@ -1806,20 +2330,25 @@ int freadMain(freadMainArgs _args) {
   // worth spending a few extra seconds sampling 10,000 rows to decrease a chance of costly reread even further.
   nJumps = 1;
   size_t sz = (size_t)(eof - pos);
-  if (jump0size>0) {
-    if (jump0size*100*2 < sz) nJumps=100;  // 100 jumps * 100 lines = 10,000 line sample
-    else if (jump0size*10*2 < sz) nJumps=10;
-    // *2 to get a good spacing. We don't want overlaps resulting in double counting.
-  }
-  if (verbose) {
-    DTPRINT(_("  Number of sampling jump points = %d because "), nJumps);
-    if (nrowLimit<INT64_MAX) DTPRINT(_("nrow limit (%"PRIu64") supplied\n"), (uint64_t)nrowLimit);
-    else if (jump0size==0) DTPRINT(_("jump0size==0\n"));
-    else DTPRINT(_("(%"PRIu64" bytes from row 1 to eof) / (2 * %"PRIu64" jump0size) == %"PRIu64"\n"),
-                 (uint64_t)sz, (uint64_t)jump0size, (uint64_t)(sz/(2*jump0size)));
+  if (args.schema) {
+    // types are known already so only jump 0 is sampled, for the nrow estimate
+    if (verbose) DTPRINT(_("  Number of sampling jump points = 1 because schema= supplied\n"));
+  } else {
+    if (jump0size>0) {
+      if (jump0size*100*2 < sz) nJumps=100;  // 100 jumps * 100 lines = 10,000 line sample
+      else if (jump0size*10*2 < sz) nJumps=10;
+      // *2 to get a good spacing. We don't want overlaps resulting in double counting.
+    }
+    if (verbose) {
+      DTPRINT(_("  Number of sampling jump points = %d because "), nJumps);
+      if (nrowLimit<INT64_MAX) DTPRINT(_("nrow limit (%"PRIu64") supplied\n"), (uint64_t)nrowLimit);
+      else if (jump0size==0) DTPRINT(_("jump0size==0\n"));
+      else DTPRINT(_("(%"PRIu64" bytes from row 1 to eof) / (2 * %"PRIu64" jump0size) == %"PRIu64"\n"),
+                   (uint64_t)sz, (uint64_t)jump0size, (uint64_t)(sz/(2*jump0size)));
+    }
+    nJumps++; // the extra sample at the very end (up to eof) is sampled and format checked but not jumped to when reading
+    if (nrowLimit<INT64_MAX && nrowLimit>0) nJumps=1; // when nrows>0 supplied by user, no jumps (not even at the end) and single threaded
   }
-  nJumps++; // the extra sample at the very end (up to eof) is sampled and format checked but not jumped to when reading
-  if (nrowLimit<INT64_MAX && nrowLimit>0) nJumps=1; // when nrows>0 supplied by user, no jumps (not even at the end) and single threaded
 
   sampleLines = 0;
   double sumLen=0.0, sumLenSq=0.0;
@@ -1966,7 +2495,7 @@ int freadMain(freadMainArgs _args) {
   meanLineLen=0.0; // Average length (in bytes) of a single line in the input file
   bytesRead=0;     // Bytes in the data section (i.e. excluding column names, header and footer, if any)
 
-  if (sampleLines <= jumpLines) {
+  if (sampleLines <= jumpLines && (!args.schema || lastRowEnd>=eof || sampleLines<2)) {
     if (verbose) DTPRINT(_("  All rows were sampled since file is small so we know nrow=%"PRIu64" exactly\n"), (uint64_t)sampleLines);
     estnrow = allocnrow = sampleLines;
   } else {
@@ -2054,6 +2583,11 @@ int freadMain(freadMainArgs _args) {
   {
   if (verbose) DTPRINT(_("[09] Apply user overrides on column types\n"));
   ch = pos;
+  {
+    // row1line is the line of the first data row at this point
+    freadSchema schema = { .types=type, .skip=row1line-1-args.header, .ncol=ncol, .sep=sep, .quoteRule=quoteRule, .header=args.header, .fill=fill };
+    saveSchema(&schema);
+  }
   memcpy(tmpType, type, (size_t)ncol) ;
   if (!userOverride(type, colNames, colNamesAnchor, ncol)) { // colNames must not be changed but type[] can be
     if (verbose) DTPRINT(_("  Cancelled by user: userOverride() returned false.")); // # nocov
@@ -2095,6 +2629,10 @@ int freadMain(freadMainArgs _args) {
   //*********************************************************************************************
   // [10] Allocate the result columns
   //*********************************************************************************************
+  int64_t fileAllocnrow = allocnrow;  // allocnrow is for the first chunk only when chunkRows>0
+  if (chunkRows && allocnrow > chunkRows) allocnrow = chunkRows + chunkRows/5;  // it's grown as usual if too few
+  // how many rows filter= keeps isn't known, so start small; it's grown in proportion to the rows kept so far as usual
+  if (args.nfilter && allocnrow > 1024) allocnrow = 1024;
   if (verbose) {
     DTPRINT(_("[10] Allocate memory for the datatable\n"));
     DTPRINT(_("  Allocating %d column slots (%d - %d dropped) with %"PRIu64" rows\n"),
@@ -2108,7 +2646,7 @@ int freadMain(freadMainArgs _args) {
   //*********************************************************************************************
   bool stopTeam=false, firstTime=true, restartTeam=false;  // bool for MT-safey (cannot ever read half written bool value badly)
   int nTypeBump=0, nTypeBumpCols=0;
-  double tRead=0, tReread=0;
+  double tRead=0, tReread=0, tRereadSum=0;
   double thRead=0, thPush=0;  // reductions of timings within the parallel region
   char *typeBumpMsg=NULL;  size_t typeBumpMsgSize=0;
   int typeCounts[NUMTYPE];  // used for verbose output; needs populating after first read and before reread (if any) -- see later comment
@@ -2133,7 +2671,17 @@ int freadMain(freadMainArgs _args) {
   // space, then this variable will tell how many new rows has to be allocated.
   int64_t extraAllocRows = 0;
 
-  if (nJumps/*from sampling*/>2) {
+  if (chunkRows) {
+    if (bytesRead==0) {
+      // small file sampled entirely in [7], so the line length wasn't needed until now
+      bytesRead = (size_t)(eof-pos);
+      meanLineLen = (double)bytesRead/umax((uint64_t)fileAllocnrow, 1);
+    }
+    // chunks end on jump points, so limit each jump to chunkRows/nth rows to give each chunk enough jumps for all threads
+    size_t maxChunkBytes = (size_t)(fmax((double)chunkRows/nth, 1.0) * meanLineLen);
+    if (chunkBytes > maxChunkBytes) chunkBytes = umax(maxChunkBytes, 1);
+  }
+  if (nJumps/*from sampling*/>2 || chunkRows) {
     // ensure data size is split into same sized chunks (no remainder in last chunk) and a multiple of nth
     // when nth==1 we still split by chunk for consistency (testing) and code sanity
     nJumps = (int)(bytesRead/chunkBytes);
@@ -2144,7 +2692,7 @@ int freadMain(freadMainArgs _args) {
     ASSERT(nJumps==1 /*when nrowLimit supplied*/ || nJumps==2 /*small files*/, "nJumps (%d) != 1|2", nJumps);
     nJumps=1;
   }
-  int64_t initialBuffRows = (int64_t)allocnrow / nJumps;
+  int64_t initialBuffRows = (int64_t)fileAllocnrow / nJumps;
 
   // Catch initialBuffRows==0 when max_nrows is small, seg fault #2243
   // Rather than 10, maybe 1 would work too but then 1.5 grow factor * 1 would still be 1. This clamp
@@ -2154,9 +2702,55 @@ int freadMain(freadMainArgs _args) {
   if (initialBuffRows > INT32_MAX) STOP(_("Buffer size %"PRId64" is too large\n"), (int64_t)initialBuffRows);
   nth = imin(nJumps, nth);
 
+  // Chunked mode reads jumps [chunkJump0, jumpEnd) into the DT, hands them over with pushChunk() and then moves on to
+  // the next jumpsPerChunk jumps. Otherwise there is just one chunk containing all the jumps.
+  int jumpsPerChunk = nJumps;
+  if (chunkRows) {
+    jumpsPerChunk = (int)fmax(1.0, fmin((double)nJumps, (double)chunkRows*meanLineLen/chunkBytes));
+    if (verbose) DTPRINT(_("  Reading in chunks of %d jumps (~%"PRId64" rows each)\n"), jumpsPerChunk, (int64_t)(jumpsPerChunk*chunkBytes/fmax(meanLineLen, 1.0)));
+  }
+  int chunkJump0 = 0, jumpEnd = jumpsPerChunk, nChunk = 0;
+  const char *chunkHeadPos = pos;  // headPos at the start of the current chunk
+  int64_t DTi0 = 0;                // rows already handed over in previous chunks
+  bool lastChunk = (jumpEnd==nJumps);
+
+  // The first read records where each jump really started; i.e. the line boundaries it found after resolving any dirty
+  // jumps. A reread due to out-of-sample type exceptions then reads exactly those ranges, so it doesn't need
+  // nextGoodLine(), doesn't land on dirty jumps to be swept, and stops where the first read stopped. readEnd is the jump
+  // after the last one to read.
+  jumpStart = (const char **)malloc(((size_t)nJumps+1) * sizeof(const char *));
+  if (!jumpStart) STOP(_("Failed to allocate %d jump positions: %s"), nJumps+1, strerror(errno));
+  jumpStart[0] = pos;
+  int readEnd = jumpEnd, jumpsDone = 0;
+
   if (verbose) DTPRINT(_("[11] Read the data\n"));
   read:  // we'll return here to reread any columns with out-of-sample type exceptions, or dirty jumps
   restartTeam = false;
+  // columns from tailCol onwards are not stored (dropped, or not being reread) so the hot loop skips them with skip_tail()
+  int tailCol = ncol;
+  while (tailCol>0 && size[tailCol-1]==0) tailCol--;
+  if (tailCol==ncol) tailCol = -1;
+  if (args.nfilter) {
+    // where each filter column is within its buffer's row: as in pushBuffer(), after the stored columns of the same size before it
+    if (!filterCol) filterCol = (FilterCol *)malloc((size_t)args.nfilter * sizeof(FilterCol));
+    if (!filterCol) STOP(_("Failed to allocate %d filter columns: %s"), args.nfilter, strerror(errno)); // # nocov
+    for (int f=0; f<args.nfilter; f++) {
+      const freadFilter *flt = args.filter + f;
+      int j = flt->col;
+      if (j<0 || j>=ncol) STOP(_("Internal error: filter condition %d is on column %d but there are %d columns"), f+1, j+1, ncol); // # nocov
+      if (type[j] < 0) continue;  // bumped during this first read; the buffers still hold it as before, so its entry stands
+      if (type[j] == CT_DROP)
+        STOP(_("Column %d%s%.*s%s is used by filter= but is being dropped. Please read it and drop it afterwards."),
+             j+1, colNames?" <<":"", colNames?(colNames[j].len):0, colNames?(colNamesAnchor+colNames[j].off):"", colNames?">>":"");
+      if ((type[j]==CT_STRING) != (flt->str!=NULL))
+        STOP(_("Column %d%s%.*s%s is being read as type '%s' so filter= cannot compare it with %s."),
+             j+1, colNames?" <<":"", colNames?(colNames[j].len):0, colNames?(colNamesAnchor+colNames[j].off):"", colNames?">>":"",
+             typeName[type[j]], flt->str ? _("a character value") : _("a number"));
+      int32_t off = 0;
+      for (int k=0; k<j; k++) if (size[k]==size[j]) off += size[k];
+      filterCol[f] = (FilterCol){ .type = type[j], .size = size[j], .off = off };
+    }
+  }
   if (verbose) DTPRINT(_("  jumps=[%d..%d), chunk_size=%"PRIu64", total_size=%"PRIu64"\n"),
                        jump0, nJumps, (uint64_t)chunkBytes, (uint64_t)(eof-pos));
   ASSERT(allocnrow <= nrowLimit, "allocnrow(%"PRIu64") <= nrowLimit(%"PRIu64")", (uint64_t)allocnrow, (uint64_t)nrowLimit);
@@ -2204,7 +2798,7 @@ int freadMain(freadMainArgs _args) {
     prepareThreadContext(&ctx);
 
     #pragma omp for ordered schedule(dynamic) reduction(+:thRead,thPush)
-    for (int jump = jump0; jump < nJumps; jump++) {
+    for (int jump = jump0; jump < readEnd; jump++) {
       if (stopTeam) continue;  // must continue and not break. We desire not to depend on (relatively new) omp cancel directive, yet
       double tLast = 0.0;      // thread local wallclock time at last measuring point for verbose mode only.
       if (verbose) tLast = wallclock();
@@ -2236,10 +2830,10 @@ int freadMain(freadMainArgs _args) {
         }
       }
 
-      const char *tch = jump==jump0 ? headPos : nextGoodLine(pos+(size_t)jump*chunkBytes, ncol);
+      const char *tch = jump==jump0 ? headPos : (firstTime ? nextGoodLine(pos+(size_t)jump*chunkBytes, ncol) : jumpStart[jump]);
       const char *thisJumpStart = tch;   // "this" for prev/this/next adjective used later, rather than a (mere) t prefix for thread-local.
       const char *tLineStart = tch;
-      const char *nextJumpStart = jump<nJumps-1 ? nextGoodLine(pos+(size_t)(jump+1)*chunkBytes, ncol) : eof;
+      const char *nextJumpStart = !firstTime ? jumpStart[jump+1] : (jump<nJumps-1 ? nextGoodLine(pos+(size_t)(jump+1)*chunkBytes, ncol) : eof);
 
       void *targets[9] = {NULL, ctx.buff1, NULL, NULL, ctx.buff4, NULL, NULL, NULL, ctx.buff8};
       FieldParseContext fctx = {
@@ -2283,8 +2877,13 @@ int freadMain(freadMainArgs _args) {
             if (thisSize) ((char **) targets)[thisSize] += thisSize;  // 'if' for when rereading to avoid undefined NULL+0
             tch++;
             j++;
+            if (j==tailCol) {
+              const char *nextLine = skip_tail(tch, ncol-j);
+              if (nextLine) { tch = nextLine; j = -1; break; }  // else go field by field as usual
+            }
           }
           //*** END HOT. START TEPID ***//
+          if (j==-1) { myNrow++; continue; }  // the rest of the line was skipped by skip_tail()
           if (tch==tLineStart) {
             skip_white(&tch);       // skips \0 before eof
             if (*tch=='\0') break;  // empty last line
@@ -2383,7 +2982,7 @@ int freadMain(freadMainArgs _args) {
                     _("Column %d%s%.*s%s bumped from '%s' to '%s' due to <<%.*s>> on row %"PRIu64"\n"),
                     j+1, colNames?" <<":"", colNames?(colNames[j].len):0, colNames?(colNamesAnchor+colNames[j].off):"", colNames?">>":"",
                     typeName[abs(joldType)], typeName[abs(thisType)],
-                    (int)(tch-fieldStart), fieldStart, (uint64_t)(ctx.DTi+myNrow));
+                    (int)(tch-fieldStart), fieldStart, (uint64_t)(DTi0+ctx.DTi+myNrow));
                   if (len > 1000) len = 1000;
                   if (len > 0) {
                     typeBumpMsg = (char*) realloc(typeBumpMsg, typeBumpMsgSize + (size_t)len + 1);
@@ -2416,6 +3015,7 @@ int freadMain(freadMainArgs _args) {
       }
       if (verbose) { double now = wallclock(); thRead += now-tLast; tLast = now; }
       ctx.anchor = thisJumpStart;
+      if (args.nfilter) myNrow = filterBuffer(&ctx, myNrow);  // so only the kept rows take up space in DT
       ctx.nRows = myNrow;
       postprocessBuffer(&ctx);
 
@@ -2439,7 +3039,7 @@ int freadMain(freadMainArgs _args) {
           if (ctx.DTi + myNrow > allocnrow) {
             // Guess for DT's nrow was insufficient. We cannot realloc DT now because other threads are pushing to DT now in
             // parallel. So, stop team, realloc and then restart reading from this jump.
-            extraAllocRows = (int64_t)((double)(DTi+myNrow)*nJumps/(jump+1) * 1.2) - allocnrow;
+            extraAllocRows = (int64_t)((double)(DTi+myNrow)*(jumpEnd-chunkJump0)/(jump-chunkJump0+1) * 1.2) - allocnrow;
             if (extraAllocRows < 1024) extraAllocRows = 1024;
             myNrow = 0;    // discard my buffer even though it was read correctly; this one jump will be reread wastefully in this rare case
             stopTeam = restartTeam = true;
@@ -2448,6 +3048,10 @@ int freadMain(freadMainArgs _args) {
             // tell next thread 2 things :
             headPos = tch;  // i) advance headPos; the jump start up to which all rows have been pushed
             DTi += myNrow;  // ii) which row in the final result next thread should start writing to since now I know myNrow.
+            if (firstTime) {
+              jumpStart[jump+1] = headPos;
+              jumpsDone = jump+1;
+            }
             ctx.nRows = myNrow;
             orderBuffer(&ctx);
             if (myStopEarly) {
@@ -2456,7 +3060,7 @@ int freadMain(freadMainArgs _args) {
                 if (quoteRuleBumpedCh == NULL) {
                   // for warning message if the quote rule bump does in fact manage to heal it, e.g. test 1881
                   quoteRuleBumpedCh = tLineStart;
-                  quoteRuleBumpedLine = row1line+DTi;
+                  quoteRuleBumpedLine = row1line+DTi0+DTi;
                 }
                 restartTeam = true;
                 jump0 = jump;  // this jump will restart from headPos, not from its beginning, e.g. test 1453
@@ -2515,11 +3119,12 @@ int freadMain(freadMainArgs _args) {
       goto read;
     }
     // else nrowLimit applied and stopped early normally
+    lastChunk = true;
   }
 
   // tell progress meter to finish up; e.g. write final newline
   // if there's a reread, the progress meter will start again from 0
-  if (args.showProgress) progress(100, 0);
+  if (args.showProgress && lastChunk) progress(100, 0);
 
   if (firstTime) {
     tReread = tRead = wallclock();
@@ -2531,15 +3136,24 @@ int freadMain(freadMainArgs _args) {
 
     if (nTypeBump) {
       if (verbose) DTPRINT(_("  %d out-of-sample type bumps: %s\n"), nTypeBump, typesAsString(ncol));
+      // save the types to continue with in the next chunk, since the reread below changes not-bumped types to -CT_STRING
+      if (chunkRows) for (int j=0; j<ncol; j++) tmpType[j] = (int8_t)abs(type[j]);
       rowSize1 = rowSize4 = rowSize8 = 0;
       nStringCols = 0;
       nNonStringCols = 0;
+      // With filter=, the reread must keep the same rows as the first read so that the rows of the columns not reread
+      // stay in step: the filter columns are reread too. If a filter column was itself bumped, which rows it keeps may
+      // change, so then all the columns are reread.
+      bool filterBumped = false;
+      for (int f=0; f<args.nfilter; f++) filterBumped |= type[args.filter[f].col]<0;
       for (int j=0, resj=-1; j<ncol; j++) {
         if (type[j] == CT_DROP) continue;
         resj++;
-        if (type[j]<0) {
-          // column was bumped due to out-of-sample type exception
-          type[j] = -type[j];
+        bool isFilterCol = filterBumped;
+        for (int f=0; f<args.nfilter && !isFilterCol; f++) isFilterCol = args.filter[f].col==j;
+        if (type[j]<0 || isFilterCol) {
+          // column was bumped due to out-of-sample type exception, or is needed to apply filter= in step with the first read
+          type[j] = (int8_t)abs(type[j]);
           size[j] = typeSize[type[j]];
           rowSize1 += (size[j] & 1);
           rowSize4 += (size[j] & 4);
@@ -2553,21 +3167,55 @@ int freadMain(freadMainArgs _args) {
         }
       }
       allocateDT(type, size, ncol, ncol - nStringCols - nNonStringCols, DTi);
-      // reread from the beginning
+      // reread from the beginning (of this chunk) up to where the first read stopped, reusing its jump boundaries
+      if (verbose) DTPRINT(_("  Rereading jumps [%d..%d) using the jump boundaries found by the first read\n"), chunkJump0, jumpsDone);
       DTi = 0;
-      headPos = pos;
-      jump0 = 0;
+      headPos = chunkHeadPos;
+      jump0 = chunkJump0;
+      readEnd = jumpsDone;
       firstTime = false;
       nSwept = 0;
       goto read;
     }
   } else {
     tReread = wallclock();
+    tRereadSum += tReread-tRead;
+  }
+
+  if (chunkRows && !lastChunk) {
+    if (verbose) DTPRINT(_("  Chunk %d of %"PRId64" rows read from jumps [%d..%d)\n"), nChunk+1, (int64_t)DTi, chunkJump0, jumpEnd);
+    pushChunk(DTi, nChunk++);
+    if (!firstTime) {
+      // restore the parse types of the columns that were skipped in this chunk's reread
+      memcpy(type, tmpType, (size_t)ncol);
+      rowSize1 = rowSize4 = rowSize8 = 0;
+      nStringCols = 0;
+      nNonStringCols = 0;
+      for (int j=0; j<ncol; j++) {
+        if (type[j] == CT_DROP) continue;
+        size[j] = typeSize[type[j]];
+        rowSize1 += (size[j] & 1);
+        rowSize4 += (size[j] & 4);
+        rowSize8 += (size[j] & 8);
+        if (type[j] == CT_STRING) nStringCols++; else nNonStringCols++;
+      }
+    }
+    allocateDT(type, size, ncol, ndrop, allocnrow);  // pushChunk() detached the columns so these are new
+    DTi0 += DTi;
+    DTi = 0;
+    chunkHeadPos = jumpStart[jumpEnd] = headPos;
+    chunkJump0 = jump0 = jumpEnd;
+    jumpEnd = readEnd = imin(jumpEnd+jumpsPerChunk, nJumps);
+    lastChunk = (jumpEnd==nJumps);
+    firstTime = true;
+    nTypeBump = 0;
+    nSwept = 0;
+    goto read;
   }
 
   double tTot = tReread-t0;  // tReread==tRead when there was no reread
   if (verbose) DTPRINT(_("Read %"PRIu64" rows x %d columns from %s file in %02d:%06.3f wall clock time\n"),
-       (uint64_t)DTi, ncol-ndrop, filesize_to_str(fileSize), (int)tTot/60, fmod(tTot,60.0));
+       (uint64_t)(DTi0+DTi), ncol-ndrop, filesize_to_str(fileSize), (int)tTot/60, fmod(tTot,60.0));
 
   //*********************************************************************************************
   // [12] Finalize the datatable
@@ -2579,7 +3227,8 @@ int freadMain(freadMainArgs _args) {
       DTPRINT(_("%10d : %-9s '%c'\n"), typeCounts[i], typeName[i], typeLetter[i]);
     }
   }
-  setFinalNrow(DTi);
+  if (!chunkRows) setFinalNrow(DTi);
+  else if (DTi || nChunk==0) pushChunk(DTi, nChunk++);
 
   if (headPos<eof && DTi<nrowLimit) {
     ch = headPos;
@@ -2598,7 +3247,7 @@ int freadMain(freadMainArgs _args) {
         ch = headPos;
         int tt = countfields(&ch);
         DTWARN(_("Stopped early on line %"PRIu64". Expected %d fields but found %d. Consider fill=TRUE and comment.char=. First discarded non-empty line: <<%s>>"),
-          (uint64_t)DTi+row1line, ncol, tt, strlim(skippedFooter,500));
+          (uint64_t)(DTi0+DTi)+row1line, ncol, tt, strlim(skippedFooter,500));
       }
     }
   }
@@ -2620,12 +3269,12 @@ int freadMain(freadMainArgs _args) {
     thRead/=nth; thPush/=nth;
     double thWaiting = tReread-tAlloc-thRead-thPush;
     DTPRINT(_("%8.3fs (%3.0f%%) Reading %d chunks (%d swept) of %.3fMB (each chunk %d rows) using %d threads\n"),
-            tReread-tAlloc, 100.0*(tReread-tAlloc)/tTot, nJumps, nSwept, (double)chunkBytes/(1024*1024), (int)(DTi/nJumps), nth);
+            tReread-tAlloc, 100.0*(tReread-tAlloc)/tTot, nJumps, nSwept, (double)chunkBytes/(1024*1024), (int)((DTi0+DTi)/nJumps), nth);
     DTPRINT(_("   + %8.3fs (%3.0f%%) Parse to row-major thread buffers (grown %d times)\n"), thRead, 100.0*thRead/tTot, buffGrown);
     DTPRINT(_("   + %8.3fs (%3.0f%%) Transpose\n"), thPush, 100.0*thPush/tTot);
     DTPRINT(_("   + %8.3fs (%3.0f%%) Waiting\n"), thWaiting, 100.0*thWaiting/tTot);
     DTPRINT(_("%8.3fs (%3.0f%%) Rereading %d columns due to out-of-sample type exceptions\n"),
-            tReread-tRead, 100.0*(tReread-tRead)/tTot, nTypeBumpCols);
+            tRereadSum, 100.0*tRereadSum/tTot, nTypeBumpCols);
     DTPRINT(_("%8.3fs        Total\n"), tTot);
     if (typeBumpMsg) {
       // if type bumps happened, it's useful to see them at the end after the timing 2 lines up showing the reread time
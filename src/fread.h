@@ -57,6 +57,43 @@ typedef struct {
 #define NA_LENOFF        INT32_MIN  // lenOff.len only; lenOff.off undefined for NA
 
 
+// The layout of an input as detected by freadMain: passed to `saveSchema()`
+// after detection, and accepted back via `freadMainArgs.schema` so that
+// another file with the same layout can be read without detecting it again.
+typedef struct freadSchema {
+  const int8_t *types;  // ncol column types as detected, before userOverride()
+  int64_t skip;         // lines before the column names (or first data row)
+  int32_t ncol;
+  char sep;             // 127 for single-column input
+  int8_t quoteRule;
+  bool header;
+  bool fill;
+} freadSchema;
+
+
+// One condition of `freadMainArgs.filter`: column `col` compared with value(s)
+// using `op`. A row is kept only if all the conditions are true for it. NA
+// never matches.
+typedef enum {
+  FILTER_EQ = 1,
+  FILTER_NE,
+  FILTER_LT,
+  FILTER_LE,
+  FILTER_GT,
+  FILTER_GE,
+  FILTER_IN    // any of the n values
+} filterOp;
+
+typedef struct freadFilter {
+  int32_t col;               // 0-based column in the file; may be set by userOverride() once the column names are known
+  int8_t op;                 // filterOp; only FILTER_EQ, FILTER_NE and FILTER_IN for strings
+  int32_t n;                 // number of values; 1 unless op is FILTER_IN
+  const double *num;         // the values for a column read as a logical, number, date or time; otherwise NULL
+  const char * const *str;   // the values for a column read as a string; otherwise NULL
+  const int32_t *strLen;
+} freadFilter;
+
+
 
 // *****************************************************************************
 
@@ -72,14 +109,41 @@ typedef struct freadMainArgs
   // with `filename`.
   const char *input;
 
+  // A file that gzip input is decompressed to when the decompressed data is too
+  // large to hold in RAM; it is then memory mapped like `filename`. NULL or ""
+  // to always decompress in RAM. The caller removes the file afterwards.
+  const char *tmpFile;
+
   // Maximum number of rows to read, or INT64_MAX to read the entire dataset.
   // Note that even if `nrowLimit = 0`, fread() will scan a sample of rows in
   // the file to detect column names and types (and other parsing settings).
   int64_t nrowLimit;
 
+  // If positive, deliver the result in chunks of approximately this many rows
+  // rather than all at once: `pushChunk()` is called after each chunk has been
+  // read, and the next chunk is then read into freshly allocated columns. Chunks
+  // always end on a jump point, so the number of rows in each chunk is an
+  // estimate based on the sample. 0 reads the whole file in one go. Cannot be
+  // used together with `nrowLimit`.
+  int64_t chunkRows;
+
   // Number of input lines to skip when reading the file.
   int64_t skipNrow;
 
+  // Conditions on already-typed columns that rows must meet to be kept. They
+  // are applied by each thread to the rows it has parsed, before the rows are
+  // pushed, so rejected rows are never written to the result. Cannot be used
+  // together with `nrowLimit`.
+  const freadFilter *filter;
+  int32_t nfilter;
+
+  // If not NULL, the layout from an earlier call (see `saveSchema()`). The
+  // separator, quote rule, header, skip and ncol are taken from it and types
+  // start from its types, so sep/quote detection and sampling are skipped. The
+  // first rows are checked to have ncol fields; fread stops if they do not.
+  // `sep`, `header`, `skipNrow` and `skipString` are ignored.
+  const freadSchema *schema;
+
   // Skip to the line containing this string. This parameter cannot be used
   // with `skipLines`.
   const char *skipString;
@@ -256,6 +320,16 @@ bool userOverride(int8_t *types, lenOff *colNames, const char *anchor,
                   const int ncol);
 
 
+/**
+ * Called once just before `userOverride()` with the layout freadMain has
+ * detected (or taken from `freadMainArgs.schema`). The implementation may
+ * copy it in order to pass it back via `freadMainArgs.schema` when reading
+ * other files with the same layout. `schema->types` is only valid during the
+ * call.
+ */
+void saveSchema(const freadSchema *schema);
+
+
 /**
  * This function is invoked by `freadMain` before the main scan of the input
  * file. It should allocate the resulting `DataTable` structure and prepare
@@ -348,6 +422,19 @@ void pushBuffer(ThreadLocalFreadParsingContext *ctx);
 void setFinalNrow(size_t nrows);
 
 
+/**
+ * Called in chunked mode (`chunkRows > 0`) each time a chunk of rows has been
+ * read completely; i.e. after any reread of that chunk due to out-of-sample
+ * type exceptions. The first `nrows` rows of the datatable are the chunk. The
+ * implementation should hand the columns over and detach them, because the
+ * next call to `allocateDT()` is expected to allocate new columns for the next
+ * chunk. Columns bumped to a higher type in one chunk stay bumped in later
+ * chunks, but chunks already delivered are not revisited. `setFinalNrow()` is
+ * not called in chunked mode; the last chunk is delivered by `pushChunk()` too.
+ */
+void pushChunk(size_t nrows, int chunk);
+
+
 /**
  * Free any srtuctures associated with the thread-local parsing context.
  */
@@ -360,6 +447,19 @@ void freeThreadContext(ThreadLocalFreadParsingContext *ctx);
 void progress(int percent/*[0,100]*/, int ETA/*secs*/);
 
 
+/**
+ * The memory holding the input: the file mapping, or the buffer that the input
+ * was copied or decompressed into; NULL when reading `input` text, which
+ * belongs to the caller. Valid from `allocateDT()` onwards. By default it is
+ * released by `freadCleanup()`; after `detachInput()` it is left in place and
+ * belongs to the caller instead, who frees it with `releaseInput()`. For
+ * implementations whose result refers to the input rather than copying it.
+ */
+const char *inputBase(void);
+void detachInput(void **addr, size_t *size, bool *mapped);
+void releaseInput(void *addr, size_t size, bool mapped);
+
+
 bool freadCleanup(void);
 double wallclock(void);
 
@@ -38,6 +38,25 @@ static SEXP DT;
 static SEXP colNamesSxp;
 static SEXP colClassesAs; // the classes like factor, POSIXct which are currently done afterwards at R level: strings don't match typeRName above => NUT / "CLASS"
 static SEXP selectRank;   // C level returns the column reording vector to be done by setcolorder() at R level afterwards
+static SEXP chunkFun;     // chunkRows>0: R function called by pushChunk() with each chunk
+static SEXP chunkAns;     // list of chunkFun results, grown as chunks are delivered
+static int nChunkAns = 0;
+static bool inChunkFun = false;  // fread's state above and in fread.c is static, so chunkFun must not call fread() itself
+static bool wantSchema;   // schema=TRUE: saveSchema() builds schemaAns which is returned as attribute 'schema'
+static SEXP schemaAns;
+static SEXP schemaNames;  // schema=<list>: its column names, which userOverride() checks the file has
+static SEXP filterNames;  // filter=: the column of each condition, which userOverride() looks up to set filters[i].col
+static freadFilter *filters;
+static bool stringsAsFactors; // stringsAsFactors=TRUE: read all string columns directly as factor
+static bool *wantFactor;      // per file column: to be read directly as factor if it is read as string; set by userOverride()
+static SEXP factorLevels;     // per file column: its levels so far in order of first appearance, or NULL when not being read as factor
+typedef struct FactorTable { int32_t *codes; size_t size; int nlevel; } FactorTable;
+static FactorTable *factorTables = NULL;  // per file column: hash table from the bytes of each level to its code
+static int nFactorTables = 0;
+static bool lazyStrings;      // lazyStrings=TRUE: string columns are made by finishLazy() as ALTREP vectors that create their strings on access
+static bool *wantLazy;        // per file column: to be read lazily if it is read as string (and not as factor); set by userOverride()
+static const char *lazyBase;  // inputBase(): pushBuffer() records each lazy field as its offset from here and its length
+static SEXP lazyInput;        // external pointer which owns the input once the first lazy column has been made
 static int8_t *type;
 static int8_t *size;
 static int ncol = 0;
@@ -46,6 +65,209 @@ static bool verbose = false;
 static bool warningsAreErrors = false;
 static bool oldNoDateTime = false;
 
+static inline uint64_t hashStr(const char *str, int len)
+{
+  uint64_t h = (uint64_t)len, w;
+  for (; len>=8; len-=8, str+=8) {
+    memcpy(&w, str, 8);
+    h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+  }
+  if (len) {
+    w = 0;
+    memcpy(&w, str, len);
+    h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+  }
+  return h ^ (h >> 32);
+}
+
+static void freeFactorTables(void)
+{
+  for (int i=0; i<nFactorTables; i++) free(factorTables[i].codes);
+  free(factorTables);
+  factorTables = NULL;
+  nFactorTables = 0;
+}
+
+// The code of the level of factor column j with these bytes, adding it as a new level if it is the first time it's been
+// seen. So mkCharLenCE() is called once per level rather than once per field. Called by pushBuffer() inside its critical.
+static int factorCode(int j, const char *str, int len)
+{
+  FactorTable *ft = factorTables + j;
+  SEXP levels = VECTOR_ELT(factorLevels, j);
+  size_t mask = ft->size-1, h = (size_t)hashStr(str, len) & mask;
+  int32_t code;
+  while ((code=ft->codes[h])) {
+    SEXP lev = STRING_ELT(levels, code-1);
+    if (LENGTH(lev)==len && memcmp(CHAR(lev), str, len)==0) return code;
+    h = (h+1) & mask;
+  }
+  code = ++ft->nlevel;
+  if (code > LENGTH(levels)) SET_VECTOR_ELT(factorLevels, j, levels=growVector(levels, 2*LENGTH(levels)));
+  SET_STRING_ELT(levels, code-1, mkCharLenCE(str, len, ienc));
+  ft->codes[h] = code;
+  if (2*(size_t)code > ft->size) {
+    // keep the table at most half full
+    size_t size = 2*ft->size;
+    int32_t *codes = (int32_t *)calloc(size, sizeof(int32_t));
+    if (!codes) return code;  // # nocov; carry on with the fuller table
+    for (int c=1; c<=code; c++) {
+      SEXP lev = STRING_ELT(levels, c-1);
+      size_t k = (size_t)hashStr(CHAR(lev), LENGTH(lev)) & (size-1);
+      while (codes[k]) k = (k+1) & (size-1);
+      codes[k] = c;
+    }
+    free(ft->codes);
+    ft->codes = codes;
+    ft->size = size;
+  }
+  return code;
+}
+
+static SEXP sortLevels;  // for levelCmp() since qsort() has no context argument
+static int levelCmp(const void *a, const void *b)
+{
+  return strcmp(CHAR(STRING_ELT(sortLevels, *(const int *)a-1)), CHAR(STRING_ELT(sortLevels, *(const int *)b-1)));
+}
+
+// Sorts the levels of factor column j in C-locale order as as_factor() at R level does, dropping any not used by the
+// first nrow codes, recodes col to match, and sets its levels and class
+static void finishFactor(SEXP col, int j, size_t nrow)
+{
+  SEXP levels = VECTOR_ELT(factorLevels, j);
+  const int nlevel = factorTables[j].nlevel;
+  int *codes = INTEGER(col);
+  int *newCode = (int *)R_alloc(nlevel+1, sizeof(int));
+  memset(newCode, 0, (nlevel+1)*sizeof(int));
+  for (size_t i=0; i<nrow; i++) if (codes[i]!=NA_INTEGER) newCode[codes[i]] = 1;
+  int *used = (int *)R_alloc(nlevel, sizeof(int));  // the old codes in use, then sorted by their level
+  int nused = 0;
+  for (int c=1; c<=nlevel; c++) if (newCode[c]) used[nused++] = c;
+  sortLevels = levels;
+  qsort(used, nused, sizeof(int), levelCmp);
+  SEXP ans = PROTECT(allocVector(STRSXP, nused));
+  for (int k=0; k<nused; k++) {
+    SET_STRING_ELT(ans, k, STRING_ELT(levels, used[k]-1));
+    newCode[used[k]] = k+1;
+  }
+  for (size_t i=0; i<nrow; i++) if (codes[i]!=NA_INTEGER) codes[i] = newCode[codes[i]];
+  setAttrib(col, R_LevelsSymbol, ans);
+  SEXP tt = PROTECT(ScalarString(char_factor));
+  setAttrib(col, R_ClassSymbol, tt);
+  UNPROTECT(2);
+}
+
+// lazyStrings=TRUE: a string column is read into a complex vector, each element holding the offset of the field in the
+// input (r) and its length (i, negative for NA), and is then made into an ALTREP character vector over the input.
+// data1 is that complex vector and data2 is lazyInput, whose finalizer frees the input once no lazy column refers to it.
+// Each element is created on access. The first access to the vector as a whole (DATAPTR, e.g. by sorting or by :=) makes
+// all the strings at once into an ordinary character vector, which then becomes data2 with data1 set to NULL.
+#include <R_ext/Rdynload.h>  // DllInfo
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 5, 0)
+#include <R_ext/Altrep.h>
+typedef struct LazyInput { void *addr; size_t size; bool mapped; cetype_t enc; } LazyInput;
+static R_altrep_class_t lazyStringClass;
+
+static void lazyInputFinalizer(SEXP ptr)
+{
+  LazyInput *in = (LazyInput *)R_ExternalPtrAddr(ptr);
+  if (!in) return;
+  releaseInput(in->addr, in->size, in->mapped);
+  free(in);
+  R_ClearExternalPtr(ptr);
+}
+
+static R_xlen_t lazyLength(SEXP x)
+{
+  SEXP fields = R_altrep_data1(x);
+  return isNull(fields) ? XLENGTH(R_altrep_data2(x)) : XLENGTH(fields);
+}
+
+static SEXP lazyElt(SEXP x, R_xlen_t i)
+{
+  SEXP fields = R_altrep_data1(x);
+  if (isNull(fields)) return STRING_ELT(R_altrep_data2(x), i);
+  const Rcomplex f = COMPLEX(fields)[i];
+  if (f.i < 0) return NA_STRING;
+  const LazyInput *in = (const LazyInput *)R_ExternalPtrAddr(R_altrep_data2(x));
+  return mkCharLenCE((const char *)in->addr + (size_t)f.r, (int)f.i, in->enc);
+}
+
+static SEXP lazyMaterialize(SEXP x)
+{
+  SEXP fields = R_altrep_data1(x);
+  if (isNull(fields)) return R_altrep_data2(x);
+  const R_xlen_t n = XLENGTH(fields);
+  SEXP ans = PROTECT(allocVector(STRSXP, n));
+  for (R_xlen_t i=0; i<n; i++) SET_STRING_ELT(ans, i, lazyElt(x, i));
+  R_set_altrep_data2(x, ans);  // drops this column's reference to lazyInput
+  R_set_altrep_data1(x, R_NilValue);
+  UNPROTECT(1);
+  return ans;
+}
+
+static void *lazyDataptr(SEXP x, Rboolean writeable)
+{
+  return (void *)DATAPTR_RO(lazyMaterialize(x));
+}
+
+static const void *lazyDataptrOrNull(SEXP x)
+{
+  return isNull(R_altrep_data1(x)) ? DATAPTR_RO(R_altrep_data2(x)) : NULL;
+}
+
+static void lazySetElt(SEXP x, R_xlen_t i, SEXP v)
+{
+  SET_STRING_ELT(lazyMaterialize(x), i, v);
+}
+
+static Rboolean lazyInspect(SEXP x, int pre, int deep, int pvec, void (*inspect_subtree)(SEXP, int, int, int))
+{
+  Rprintf(" fread lazy strings (%s)\n", isNull(R_altrep_data1(x)) ? "materialized" : "not materialized");
+  return TRUE;
+}
+
+void initLazyStrings(DllInfo *info)
+{
+  lazyStringClass = R_make_altstring_class("fread_lazy_string", "data.table", info);
+  R_set_altrep_Length_method(lazyStringClass, lazyLength);
+  R_set_altrep_Inspect_method(lazyStringClass, lazyInspect);
+  R_set_altvec_Dataptr_method(lazyStringClass, lazyDataptr);
+  R_set_altvec_Dataptr_or_null_method(lazyStringClass, lazyDataptrOrNull);
+  R_set_altstring_Elt_method(lazyStringClass, lazyElt);
+  R_set_altstring_Set_elt_method(lazyStringClass, lazySetElt);
+}
+
+static SEXP makeLazy(SEXP fields)
+{
+  if (isNull(lazyInput)) {
+    LazyInput *in = (LazyInput *)malloc(sizeof(LazyInput));
+    if (!in) STOP(_("Failed to allocate the lazy string input")); // # nocov
+    detachInput(&in->addr, &in->size, &in->mapped);
+    in->enc = ienc;
+    SET_VECTOR_ELT(RCHK, 7, lazyInput=R_MakeExternalPtr(in, R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(lazyInput, lazyInputFinalizer, FALSE);
+  }
+  return R_new_altrep(lazyStringClass, fields, lazyInput);
+}
+#else
+void initLazyStrings(DllInfo *info) {}
+static SEXP makeLazy(SEXP fields) { return fields; }  // # nocov; lazyStrings=TRUE is an error before R 3.5.0 so not reached
+#endif
+
+// Makes the lazy columns among the first nrow rows of cols into ALTREP character vectors; cols as for finishFactors()
+static void finishLazy(SEXP cols, size_t nrow) {
+  for (int j=0, resj=0; j<ncol; j++) {
+    if (type[j]==CT_DROP) continue;
+    SEXP col = VECTOR_ELT(cols, resj);
+    if (TYPEOF(col)==CPLXSXP) {
+      SETLENGTH(col, nrow);
+      SET_TRUELENGTH(col, nrow);
+      SET_VECTOR_ELT(cols, resj, makeLazy(col));
+    }
+    resj++;
+  }
+}
 
 SEXP freadR(
   // params passed to freadMain
@@ -74,8 +296,17 @@ SEXP freadR(
   SEXP integer64Arg,
   SEXP encodingArg,
   SEXP keepLeadingZerosArgs,
-  SEXP noTZasUTC
+  SEXP noTZasUTC,
+  SEXP chunkRowsArg,
+  SEXP chunkFunArg,
+  SEXP schemaArg,
+  SEXP filterArg,
+  SEXP stringsAsFactorsArg,
+  SEXP lazyStringsArg,
+  SEXP tmpFileArg
 ) {
+  if (inChunkFun)
+    error(_("fread() cannot be called from within the chunkFun= of another fread() because the state of the outer fread() would be overwritten. Please read the other file before or after, or collect what chunkFun needs and read it afterwards."));
   verbose = LOGICAL(verboseArg)[0];
   warningsAreErrors = LOGICAL(warnings2errorsArg)[0];
 
@@ -97,6 +328,9 @@ SEXP freadR(
     args.filename = NULL;
     args.input = ch;
   }
+  if (!isString(tmpFileArg) || LENGTH(tmpFileArg)!=1)
+    error(_("Internal error: freadR tmpFile not a single character string"));  // # nocov
+  args.tmpFile = CHAR(STRING_ELT(tmpFileArg,0));  // from tempfile() so already absolute; R_ExpandFileName() has one static buffer
 
   if (!isString(sepArg) || LENGTH(sepArg)!=1 || strlen(CHAR(STRING_ELT(sepArg,0)))>1)
     error(_("Internal error: freadR sep not a single character. R level catches this."));  // # nocov
@@ -126,6 +360,44 @@ SEXP freadR(
   if (R_FINITE(REAL(nrowLimitArg)[0]) && REAL(nrowLimitArg)[0]>=0.0)
     args.nrowLimit = (int64_t)(REAL(nrowLimitArg)[0]);
 
+  if (!isReal(chunkRowsArg) || length(chunkRowsArg)!=1 || !R_FINITE(REAL(chunkRowsArg)[0]) || REAL(chunkRowsArg)[0]<0.0)
+    error(_("Internal error: freadR chunkRows not a single finite non-negative real. R level catches this."));  // # nocov
+  args.chunkRows = (int64_t)(REAL(chunkRowsArg)[0]);
+  if (args.chunkRows && !isFunction(chunkFunArg))
+    error(_("Internal error: freadR chunkFun is not a function. R level catches this."));  // # nocov
+  chunkFun = chunkFunArg;
+
+  args.schema = NULL;
+  freadSchema schema;
+  wantSchema = false;
+  schemaNames = R_NilValue;
+  if (isLogical(schemaArg)) {
+    wantSchema = LENGTH(schemaArg)==1 && LOGICAL(schemaArg)[0]==TRUE;
+  } else if (!isNull(schemaArg)) {
+    // list(sep, quoteRule, header, skip, fill, types, names) as built by saveSchema() below
+    if (!isNewList(schemaArg) || LENGTH(schemaArg)!=7)
+      error(_("Internal error: freadR schema is not NULL, TRUE or a list of length 7. R level catches this."));  // # nocov
+    SEXP sepSxp=VECTOR_ELT(schemaArg,0), quoteRuleSxp=VECTOR_ELT(schemaArg,1), headerSxp=VECTOR_ELT(schemaArg,2), skipSxp=VECTOR_ELT(schemaArg,3),
+         fillSxp=VECTOR_ELT(schemaArg,4), typesSxp=VECTOR_ELT(schemaArg,5);
+    schemaNames = VECTOR_ELT(schemaArg,6);
+    if (!isString(sepSxp) || LENGTH(sepSxp)!=1 || LENGTH(STRING_ELT(sepSxp,0))!=1 ||
+        !isInteger(quoteRuleSxp) || LENGTH(quoteRuleSxp)!=1 || INTEGER(quoteRuleSxp)[0]<0 || INTEGER(quoteRuleSxp)[0]>3 ||
+        !isLogical(headerSxp) || LENGTH(headerSxp)!=1 || LOGICAL(headerSxp)[0]==NA_LOGICAL ||
+        !isInteger(skipSxp) || LENGTH(skipSxp)!=1 || INTEGER(skipSxp)[0]<0 ||
+        !isLogical(fillSxp) || LENGTH(fillSxp)!=1 || LOGICAL(fillSxp)[0]==NA_LOGICAL ||
+        !isInteger(typesSxp) || LENGTH(typesSxp)<1 || !isString(schemaNames) || LENGTH(schemaNames)!=LENGTH(typesSxp))
+      error(_("schema= has been modified or is not from fread(..., schema=TRUE)"));
+    const int n = LENGTH(typesSxp), *typesD = INTEGER(typesSxp);
+    int8_t *types = (int8_t *)R_alloc(n, sizeof(int8_t));
+    for (int i=0; i<n; i++) {
+      if (typesD[i]<=CT_DROP || typesD[i]>=NUMTYPE) error(_("schema= has been modified or is not from fread(..., schema=TRUE)"));
+      types[i] = (int8_t)typesD[i];
+    }
+    schema = (freadSchema){ .types=types, .skip=INTEGER(skipSxp)[0], .ncol=n, .sep=CHAR(STRING_ELT(sepSxp,0))[0],
+                            .quoteRule=(int8_t)INTEGER(quoteRuleSxp)[0], .header=LOGICAL(headerSxp)[0], .fill=LOGICAL(fillSxp)[0] };
+    args.schema = &schema;
+  }
+
   args.logical01 = LOGICAL(logical01Arg)[0];
   {
     SEXP tt = PROTECT(GetOption(sym_old_fread_datetime_character, R_NilValue));
@@ -209,14 +481,92 @@ SEXP freadR(
   else if (strcmp(tt, "Latin-1")==0) ienc = CE_LATIN1;
   else if (strcmp(tt, "UTF-8")==0) ienc = CE_UTF8;
   else STOP(_("encoding='%s' invalid. Must be 'unknown', 'Latin-1' or 'UTF-8'"), tt);  // # nocov
+
+  args.filter = NULL;
+  args.nfilter = 0;
+  filterNames = R_NilValue;
+  if (!isNull(filterArg)) {
+    // list(cols, ops, values) as built at R level from the filter= expression; values are double or (without NA) character
+    if (!isNewList(filterArg) || LENGTH(filterArg)!=3)
+      error(_("Internal error: freadR filter is not NULL or a list of length 3. R level catches this."));  // # nocov
+    filterNames = VECTOR_ELT(filterArg, 0);
+    SEXP opsSxp = VECTOR_ELT(filterArg, 1), valuesSxp = VECTOR_ELT(filterArg, 2);
+    const int n = LENGTH(filterNames);
+    filters = (freadFilter *)R_alloc(n, sizeof(freadFilter));
+    for (int i=0; i<n; i++) {
+      SEXP v = VECTOR_ELT(valuesSxp, i);
+      filters[i] = (freadFilter){ .col=-1, .op=(int8_t)INTEGER(opsSxp)[i], .n=LENGTH(v) };
+      if (isReal(v)) {
+        filters[i].num = REAL(v);
+      } else {
+        // compared byte for byte with the field, so in the same encoding as the file
+        const char **str = (const char **)R_alloc(LENGTH(v), sizeof(char *));
+        int32_t *strLen = (int32_t *)R_alloc(LENGTH(v), sizeof(int32_t));
+        for (int k=0; k<LENGTH(v); k++) {
+          str[k] = ienc==CE_UTF8 ? translateCharUTF8(STRING_ELT(v, k)) : CHAR(STRING_ELT(v, k));
+          strLen[k] = (int32_t)strlen(str[k]);
+        }
+        filters[i].str = str;
+        filters[i].strLen = strLen;
+      }
+    }
+    args.filter = filters;
+    args.nfilter = n;
+  }
   // === end extras ===
 
-  RCHK = PROTECT(allocVector(VECSXP, 4));
+  stringsAsFactors = LOGICAL(stringsAsFactorsArg)[0]==TRUE;
+  wantFactor = NULL;
+  freeFactorTables();
+  factorLevels = R_NilValue;
+  lazyStrings = LOGICAL(lazyStringsArg)[0]==TRUE && args.filename;  // text input is not ours to keep
+  #if !defined(R_VERSION) || R_VERSION < R_Version(3, 5, 0)
+  if (lazyStrings) error(_("lazyStrings=TRUE requires R 3.5.0 or later for ALTREP")); // # nocov
+  #endif
+  wantLazy = NULL;
+  lazyBase = NULL;
+  lazyInput = R_NilValue;
+
+  RCHK = PROTECT(allocVector(VECSXP, 8));
   // see kalibera/rchk#9 and Rdatatable/data.table#2865.  To avoid rchk false positives.
   // allocateDT() assigns DT to position 0. userOverride() assigns colNamesSxp to position 1 and colClassesAs to position 2 (both used in allocateDT())
+  // pushChunk() assigns chunkAns to position 4 and saveSchema() assigns schemaAns to position 5
+  // allocateDT() assigns factorLevels to position 6 and makeLazy() assigns lazyInput to position 7
+  chunkAns = R_NilValue;
+  nChunkAns = 0;
+  schemaAns = R_NilValue;
   freadMain(args);
+  SEXP ans = DT;
+  if (args.chunkRows) SET_VECTOR_ELT(RCHK, 4, ans = nChunkAns ? growVector(chunkAns, nChunkAns) : allocVector(VECSXP, 0));
+  if (wantSchema && !isNull(schemaAns)) {
+    SET_VECTOR_ELT(schemaAns, 6, colNamesSxp);  // all column names in the file, before select= and drop=
+    setAttrib(ans, sym_schema, schemaAns);
+  }
+  freeFactorTables();
   UNPROTECT(1);
-  return DT;
+  return ans;
+}
+
+void saveSchema(const freadSchema *schema)
+{
+  if (!wantSchema) return;
+  const int ncol = schema->ncol;
+  SET_VECTOR_ELT(RCHK, 5, schemaAns=allocVector(VECSXP, 7));
+  SET_VECTOR_ELT(schemaAns, 0, ScalarString(mkCharLen(&schema->sep, 1)));
+  SET_VECTOR_ELT(schemaAns, 1, ScalarInteger(schema->quoteRule));
+  SET_VECTOR_ELT(schemaAns, 2, ScalarLogical(schema->header));
+  SET_VECTOR_ELT(schemaAns, 3, ScalarInteger((int)schema->skip));
+  SET_VECTOR_ELT(schemaAns, 4, ScalarLogical(schema->fill));
+  SEXP types;
+  SET_VECTOR_ELT(schemaAns, 5, types=allocVector(INTSXP, ncol));
+  for (int i=0; i<ncol; i++) INTEGER(types)[i] = schema->types[i];
+  // names are added once userOverride() has created them
+  SEXP names = PROTECT(allocVector(STRSXP, 7));
+  const char *nm[7] = {"sep", "quoteRule", "header", "skip", "fill", "types", "names"};
+  for (int i=0; i<7; i++) SET_STRING_ELT(names, i, mkChar(nm[i]));
+  setAttrib(schemaAns, R_NamesSymbol, names);
+  setAttrib(schemaAns, R_ClassSymbol, PROTECT(mkString("fread_schema")));
+  UNPROTECT(2);
 }
 
 static void applyDrop(SEXP items, int8_t *type, int ncol, int dropSource) {
@@ -264,6 +614,22 @@ bool userOverride(int8_t *type, lenOff *colNames, const char *anchor, const int
     }
     SET_STRING_ELT(colNamesSxp, i, elem);
   }
+  if (!isNull(schemaNames)) {
+    // fail before reading rather than return a table whose columns are not the ones the schema is for
+    for (int i=0; i<ncol; i++) if (STRING_ELT(schemaNames, i) != STRING_ELT(colNamesSxp, i))
+      STOP(_("Column %d is named '%s' in this input but '%s' in schema= so this input does not have the same layout. Remove schema= to detect its layout."),
+           i+1, CHAR(STRING_ELT(colNamesSxp, i)), CHAR(STRING_ELT(schemaNames, i)));
+  }
+  if (!isNull(filterNames)) {
+    const int *m = INTEGER(PROTECT(chmatch(filterNames, colNamesSxp, NA_INTEGER)));
+    for (int i=0; i<LENGTH(filterNames); i++) {
+      if (m[i]==NA_INTEGER)
+        STOP(_("Column '%s' in filter= is not a column name in this input (case sensitive). Column names in filter= are those in the input, before col.names= is applied."),
+             CHAR(STRING_ELT(filterNames, i)));
+      filters[i].col = m[i]-1;
+    }
+    UNPROTECT(1);
+  }
   // "use either select= or drop= but not both" was checked earlier in freadR
   applyDrop(dropSxp, type, ncol, /*dropSource=*/-1);
   if (TYPEOF(colClassesSxp)==VECSXP) {  // not isNewList() because that returns true for NULL
@@ -422,6 +788,16 @@ bool userOverride(int8_t *type, lenOff *colNames, const char *anchor, const int
   if (readInt64As != CT_INT64) {
     for (int i=0; i<ncol; i++) if (type[i]==CT_INT64) type[i] = readInt64As;
   }
+  // colClasses="factor" columns are read as string (see "CLASS" in typeRName above) and, like stringsAsFactors=TRUE, directly
+  // as factor then rather than converted afterwards at R level. Not other colClassesAs since they are converted from character.
+  wantFactor = (bool *)R_alloc(ncol, sizeof(bool));
+  for (int i=0; i<ncol; i++) {
+    SEXP as = colClassesAs ? STRING_ELT(colClassesAs, i) : R_BlankString;
+    wantFactor[i] = as==char_factor || (stringsAsFactors && as==R_BlankString);
+    if (as==char_factor) SET_STRING_ELT(colClassesAs, i, R_BlankString);
+  }
+  wantLazy = (bool *)R_alloc(ncol, sizeof(bool));
+  for (int i=0; i<ncol; i++) wantLazy[i] = lazyStrings && !wantFactor[i];
   return true;
 }
 
@@ -435,6 +811,11 @@ size_t allocateDT(int8_t *typeArg, int8_t *sizeArg, int ncolArg, int ndrop, size
     ncol = ncolArg;
     dtnrows = allocNrow;
     SET_VECTOR_ELT(RCHK, 0, DT=allocVector(VECSXP, ncol-ndrop));
+    SET_VECTOR_ELT(RCHK, 6, factorLevels=allocVector(VECSXP, ncol));
+    factorTables = (FactorTable *)calloc(ncol, sizeof(FactorTable));
+    if (!factorTables) STOP(_("Failed to allocate %d factor level tables"), ncol); // # nocov
+    nFactorTables = ncol;
+    lazyBase = inputBase();
     if (ndrop==0) {
       setAttrib(DT, R_NamesSymbol, colNamesSxp);  // colNames mkChar'd in userOverride step
       if (colClassesAs) setAttrib(DT, sym_colClassesAs, colClassesAs);
@@ -483,10 +864,22 @@ size_t allocateDT(int8_t *typeArg, int8_t *sizeArg, int ncolArg, int ndrop, size
     SEXP col = VECTOR_ELT(DT, resi);
     int oldIsInt64 = newDT? 0 : INHERITS(col, char_integer64);
     int newIsInt64 = type[i] == CT_INT64;
-    int typeChanged = (type[i] > 0) && (newDT || TYPEOF(col) != typeSxp[type[i]] || oldIsInt64 != newIsInt64);
+    int oldIsFactor = !isNull(VECTOR_ELT(factorLevels, i));
+    int newIsFactor = type[i] == CT_STRING && wantFactor[i];
+    int newIsLazy = type[i] == CT_STRING && wantLazy[i];  // only lazy columns are read into complex vectors, see finishLazy()
+    int newSxp = newIsFactor ? INTSXP : newIsLazy ? CPLXSXP : typeSxp[type[i]];
+    int typeChanged = (type[i] > 0) && (newDT || TYPEOF(col) != newSxp || oldIsInt64 != newIsInt64 || oldIsFactor != newIsFactor);
     int nrowChanged = (allocNrow != dtnrows);
+    if (typeChanged) {
+      // a factor column's codes are written by pushBuffer() and its levels and class are set by finishFactor() at the end
+      SET_VECTOR_ELT(factorLevels, i, newIsFactor ? allocVector(STRSXP, 64) : R_NilValue);
+      FactorTable *ft = factorTables + i;
+      free(ft->codes);
+      *ft = (FactorTable){ .codes = newIsFactor ? (int32_t *)calloc(128, sizeof(int32_t)) : NULL, .size = newIsFactor ? 128 : 0, .nlevel = 0 };
+      if (newIsFactor && !ft->codes) STOP(_("Failed to allocate the level table for column %d"), i+1); // # nocov
+    }
     if (typeChanged || nrowChanged) {
-      SEXP thiscol = typeChanged ? allocVector(typeSxp[type[i]], allocNrow)  // no need to PROTECT, passed immediately to SET_VECTOR_ELT, see R-exts 5.9.1
+      SEXP thiscol = typeChanged ? allocVector(newSxp, allocNrow)  // no need to PROTECT, passed immediately to SET_VECTOR_ELT, see R-exts 5.9.1
                                  : growVector(col, allocNrow);
       SET_VECTOR_ELT(DT,resi,thiscol);
       if (type[i]==CT_INT64) {
@@ -518,12 +911,24 @@ size_t allocateDT(int8_t *typeArg, int8_t *sizeArg, int ncolArg, int ndrop, size
 }
 
 
+static void finishFactors(SEXP cols, size_t nrow) {
+  // cols are in file order with the dropped columns left out, as DT is before setcolorder()
+  for (int j=0, resj=0; j<ncol; j++) {
+    if (type[j]==CT_DROP) continue;
+    if (!isNull(VECTOR_ELT(factorLevels, j))) finishFactor(VECTOR_ELT(cols, resj), j, nrow);
+    resj++;
+  }
+}
+
 void setFinalNrow(size_t nrow) {
+  if (length(DT)) finishFactors(DT, nrow);
+  if (length(DT) && lazyStrings) finishLazy(DT, nrow);
   if (selectRank) setcolorder(DT, selectRank);  // selectRank was changed to contain order (not rank) in allocateDT above
   if (length(DT)) {
     if (nrow == dtnrows)
       return;
     for (int i=0; i<LENGTH(DT); i++) {
+      if (ALTREP(VECTOR_ELT(DT,i))) continue;  // lazy strings, already made with length nrow by finishLazy()
       SETLENGTH(VECTOR_ELT(DT,i), nrow);  // TODO: realloc
       SET_TRUELENGTH(VECTOR_ELT(DT,i), nrow);
     }
@@ -532,6 +937,66 @@ void setFinalNrow(size_t nrow) {
 }
 
 
+void pushChunk(size_t nrow, int chunk) {
+  // Move the columns into a new list for chunkFun, leaving NULL in DT so that the next allocateDT() allocates new columns
+  // rather than overwriting this chunk which chunkFun may have kept a reference to.
+  const int n = LENGTH(DT);
+  SEXP ans = PROTECT(allocVector(VECSXP, n));
+  for (int i=0; i<n; i++) {
+    SEXP col = VECTOR_ELT(DT, i);
+    SETLENGTH(col, nrow);
+    SET_TRUELENGTH(col, nrow);
+    SET_VECTOR_ELT(ans, i, col);
+    SET_VECTOR_ELT(DT, i, R_NilValue);
+  }
+  finishFactors(ans, nrow);  // the next chunk's factor columns start afresh when allocateDT() allocates them
+  if (lazyStrings) finishLazy(ans, nrow);
+  setAttrib(ans, R_NamesSymbol, PROTECT(duplicate(getAttrib(DT, R_NamesSymbol))));
+  SEXP tt = getAttrib(DT, sym_colClassesAs);
+  if (!isNull(tt)) setAttrib(ans, sym_colClassesAs, tt);
+  if (selectRank) setcolorder(ans, selectRank);  // colClassesAs is already in select order, see allocateDT()
+  R_FlushConsole();
+  if (isNull(chunkAns)) SET_VECTOR_ELT(RCHK, 4, chunkAns=allocVector(VECSXP, 16));
+  else if (nChunkAns == LENGTH(chunkAns)) SET_VECTOR_ELT(RCHK, 4, chunkAns=growVector(chunkAns, 2*nChunkAns));
+  SEXP call = PROTECT(lang2(chunkFun, ans));
+  int err = 0;
+  inChunkFun = true;
+  SEXP res = R_tryEval(call, R_GlobalEnv, &err);  // not eval() so that freadCleanup() still happens via STOP on error
+  inChunkFun = false;                            // R_tryEval() always returns, so this is always reset
+  if (err) STOP(_("chunkFun failed on chunk %d with the error above; reading stopped."), chunk+1);
+  SET_VECTOR_ELT(chunkAns, nChunkAns++, res);
+  UNPROTECT(3);
+}
+
+// Sets first[i] to the row of the first field in the buffer equal to field i, so that pushBuffer() only needs to call
+// mkCharLenCE() once for each distinct string and can reuse the CHARSXP for the rest. Gives up (sets first[0] to -1)
+// when the first 1000 rows are more than half distinct, as hashing would then cost more than it saves.
+static void dedupStrings(const lenOff *source, int cnt8, int nRows, const char *anchor, int32_t *first, int32_t *table, size_t tableSize)
+{
+  const size_t mask = tableSize-1;
+  memset(table, 0xff, tableSize*sizeof(int32_t));  // -1 is empty
+  int nuniq = 0;
+  const lenOff *src = source;
+  for (int i=0; i<nRows; i++, src+=cnt8) {
+    if (i==1000 && nuniq>500) { first[0] = -1; return; }
+    first[i] = i;
+    const int len = src->len;
+    if (len<=0) continue;  // NA or ""
+    const char *str = anchor + src->off;
+    size_t h = (size_t)hashStr(str, len) & mask;
+    int32_t k;
+    while ((k=table[h]) != -1) {
+      const lenOff *prev = source + (size_t)k*cnt8;
+      if (prev->len==len && memcmp(anchor+prev->off, str, len)==0) { first[i] = k; break; }
+      h = (h+1) & mask;
+    }
+    if (k == -1) {
+      table[h] = i;
+      nuniq++;
+    }
+  }
+}
+
 void pushBuffer(ThreadLocalFreadParsingContext *ctx)
 {
   const void *buff8 = ctx->buff8;
@@ -554,42 +1019,100 @@ void pushBuffer(ThreadLocalFreadParsingContext *ctx)
 
   // the byte position of this column in the first row of the row-major buffer
   if (nStringCols) {
-    #pragma omp critical
-    {
-      int off8 = 0;
-      int cnt8 = rowSize8 / 8;
-      lenOff *buff8_lenoffs = (lenOff*) buff8;
-      for (int j=0, resj=-1, done=0; done<nStringCols && j<ncol; j++) {
-        if (type[j] == CT_DROP) continue;
-        resj++;
-        if (type[j] == CT_STRING) {
-          SEXP dest = VECTOR_ELT(DT, resj);
-          lenOff *source = buff8_lenoffs + off8;
-          for (int i=0; i<nRows; i++) {
-            int strLen = source->len;
-            if (strLen<=0) {
-              // stringLen == INT_MIN => NA, otherwise not a NAstring was checked inside fread_mean
-              if (strLen<0) SET_STRING_ELT(dest, DTi+i, NA_STRING); // else leave the "" in place that was initialized by allocVector()
-            } else {
-              const char *str = anchor + source->off;
-              int c=0;
-              while (c<strLen && str[c]) c++;
-              if (c<strLen) {
-                // embedded nul found; any at the beginning or the end of the field should have already been excluded but this will strip those too if present just in case
-                char *last = (char *)str+c;    // obtain write access to (const char *)anchor;
-                while (c<strLen) {
-                  if (str[c]) *last++=str[c];  // cow page write: saves allocation and management of a temp that would need to thread-safe in future.
-                  c++;                         //   This is only thread accessing this region. For non-mmap direct input nul are not possible (R would not have accepted nul earlier).
-                }
-                strLen = last-str;
+    // Strip any embedded nul from the fields first, outside the critical, so that only the interning by mkCharLenCE()
+    // (which uses R's global CHARSXP cache so cannot be done by more than one thread at a time) is left inside it.
+    // memchr() is much faster than the byte at a time scan there used to be for this inside the critical.
+    // Then find the repeated strings within the buffer so that each distinct string is interned just once; on low
+    // cardinality columns that cuts the time inside the critical by the average number of repeats in a buffer.
+    int off8 = 0;
+    const int cnt8 = rowSize8 / 8;
+    if (ctx->strCap < (size_t)nRows) {
+      size_t cap = 1024;
+      while (cap < (size_t)nRows) cap *= 2;
+      free(ctx->strFirst);
+      free(ctx->strTable);
+      ctx->strFirst = (int32_t *)malloc((size_t)nStringCols * cap * sizeof(int32_t));
+      ctx->strTable = (int32_t *)malloc(2 * cap * sizeof(int32_t));  // at most half full
+      ctx->strCap = (ctx->strFirst && ctx->strTable) ? cap : 0;      // if out of memory, just intern every string
+    }
+    const bool dedup = ctx->strCap > 0;
+    int nEager = 0;  // string columns left for the critical; lazy ones are written here
+    for (int j=0, resj=-1, done=0; done<nStringCols && j<ncol; j++) {
+      if (type[j] == CT_DROP) continue;
+      resj++;
+      if (type[j] == CT_STRING) {
+        lenOff *source = (lenOff*) ctx->buff8 + off8;  // this thread's buffer so ok to update len in place
+        for (int i=0; i<nRows; i++, source += cnt8) {
+          if (source->len <= 0) continue;
+          char *str = (char *)anchor + source->off;  // obtain write access to (const char *)anchor;
+          char *last = memchr(str, '\0', source->len);
+          if (!last) continue;
+          // embedded nul found; any at the beginning or the end of the field should have already been excluded but this will strip those too if present just in case
+          char *end = str+source->len;
+          for (const char *c=last; c<end; c++) {
+            if (*c) *last++=*c;  // cow page write: saves allocation and management of a temp that would need to thread-safe in future.
+          }                      //   This is only thread accessing this region. For non-mmap direct input nul are not possible (R would not have accepted nul earlier).
+          source->len = (int)(last-str);
+          memset(last, 0, end-last);  // nul rather than the stale tail so that a reread of this field (filter=) strips to the same string
+
+        }
+        if (wantLazy[j]) {
+          // the offset of each field in the input and its length; each thread writes its own rows so no critical needed
+          Rcomplex *dest = COMPLEX(VECTOR_ELT(DT, resj)) + DTi;
+          const lenOff *src = (const lenOff *)ctx->buff8 + off8;
+          const double base = (double)(anchor - lazyBase);
+          for (int i=0; i<nRows; i++, src+=cnt8) {
+            dest[i].r = base + src->off;
+            dest[i].i = src->len<0 ? -1 : src->len;
+          }
+          done++;
+          off8 += (size[j] == 8);
+          continue;
+        }
+        nEager++;
+        if (dedup) dedupStrings((lenOff*) ctx->buff8 + off8, cnt8, nRows, anchor, ctx->strFirst + (size_t)done*nRows, ctx->strTable, 2*ctx->strCap);
+        done++;
+      }
+      off8 += (size[j] == 8);
+    }
+    if (nEager) {  // not all lazy
+      #pragma omp critical
+      {
+        off8 = 0;
+        lenOff *buff8_lenoffs = (lenOff*) buff8;
+        for (int j=0, resj=-1, done=0; done<nStringCols && j<ncol; j++) {
+          if (type[j] == CT_DROP) continue;
+          resj++;
+          if (type[j] == CT_STRING && wantLazy[j]) {
+            done++;  // written above
+          } else if (type[j] == CT_STRING) {
+            SEXP dest = VECTOR_ELT(DT, resj);
+            const lenOff *source = buff8_lenoffs + off8;
+            const int32_t *first = dedup ? ctx->strFirst + (size_t)done*nRows : NULL;
+            if (first && first[0]==-1) first = NULL;  // dedupStrings() gave up on this column
+            if (!isNull(VECTOR_ELT(factorLevels, j))) {
+              // read directly as factor: write the level codes, so no character vector is created
+              int *codes = INTEGER(dest) + DTi;
+              for (int i=0; i<nRows; i++, source+=cnt8) {
+                const int strLen = source->len;
+                codes[i] = strLen<0 ? NA_INTEGER : (first && first[i]!=i) ? codes[first[i]] : factorCode(j, anchor + source->off, strLen);
+              }
+            } else for (int i=0; i<nRows; i++) {
+              int strLen = source->len;
+              if (strLen<=0) {
+                // stringLen == INT_MIN => NA, otherwise not a NAstring was checked inside fread_mean
+                if (strLen<0) SET_STRING_ELT(dest, DTi+i, NA_STRING); // else leave the "" in place that was initialized by allocVector()
+              } else if (first && first[i]!=i) {
+                SET_STRING_ELT(dest, DTi+i, STRING_ELT(dest, DTi+first[i]));  // same string as an earlier row in this buffer
+              } else {
+                SET_STRING_ELT(dest, DTi+i, mkCharLenCE(anchor + source->off, strLen, ienc));
               }
-              SET_STRING_ELT(dest, DTi+i, mkCharLenCE(str, strLen, ienc));
+              source += cnt8;
             }
-            source += cnt8;
+            done++; // if just one string col near the start, don't loop over the other 10,000 cols. TODO? start on first too
           }
-          done++; // if just one string col near the start, don't loop over the other 10,000 cols. TODO? start on first too
+          off8 += (size[j] == 8);
         }
-        off8 += (size[j] == 8);
       }
     }
   }
@@ -694,6 +1217,7 @@ void __halt(bool warn, const char *format, ...) {
   vsnprintf(msg, 2000, format, args);
   va_end(args);
   freadCleanup(); // this closes mmp hence why we just copied substrings from mmp to msg[] first since mmp is now invalid
+  freeFactorTables();
   // if (warn) warning(_("%s"), msg);
   //   this warning() call doesn't seem to honor warn=2 straight away in R 3.6, so now always call error() directly to be sure
   //   we were going via warning() before to get the (converted from warning) prefix in the message (which we could mimic in future)
@@ -703,4 +1227,8 @@ void __halt(bool warn, const char *format, ...) {
 void prepareThreadContext(ThreadLocalFreadParsingContext *ctx) {}
 void postprocessBuffer(ThreadLocalFreadParsingContext *ctx) {}
 void orderBuffer(ThreadLocalFreadParsingContext *ctx) {}
-void freeThreadContext(ThreadLocalFreadParsingContext *ctx) {}
+void freeThreadContext(ThreadLocalFreadParsingContext *ctx) {
+  free(ctx->strFirst); ctx->strFirst = NULL;
+  free(ctx->strTable); ctx->strTable = NULL;
+  ctx->strCap = 0;
+}
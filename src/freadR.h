@@ -10,7 +10,10 @@
 
 #define FREAD_PUSH_BUFFERS_EXTRA_FIELDS \
   int nStringCols; \
-  int nNonStringCols;
+  int nNonStringCols; \
+  int32_t *strFirst;  /* pushBuffer(): for each string field, the buffer row of the first field equal to it */ \
+  int32_t *strTable;  /* pushBuffer(): hash table of those first rows */ \
+  size_t strCap;      /* rows that strFirst and strTable have room for */
 
 // Before error() [or warning() with options(warn=2)] call freadCleanup() to close mmp and fix :
 //   http://stackoverflow.com/questions/18597123/fread-data-table-locks-files
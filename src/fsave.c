@@ -0,0 +1,449 @@
+#include "data.table.h"
+#include <errno.h>
+#include <string.h>    // strerror, memcpy
+#ifndef NOZLIB
+#include <zlib.h>      // compress2 and uncompress for compress=TRUE
+#endif
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>  // mmap
+  #include <sys/stat.h>  // fstat for filesize
+  #include <fcntl.h>     // open
+  #include <unistd.h>    // close
+#endif
+
+/*
+ * fsave() and fload(): a binary columnar snapshot of a data.table, for passing tables between jobs without formatting
+ * numbers to text and parsing them back. All integers are in the writer's native byte order, which fload() checks.
+ *
+ *   "DTSNAP\0\1"                      magic and format version
+ *   uint32 0x01020304, uint32 0       byte order mark
+ *   column data                       column by column, each in blocks of SNAP_BLOCK bytes (the last one shorter),
+ *                                     each block deflated when compress=TRUE and that made it smaller
+ *   SnapHead, SnapCol[ncol], int64 blockSize[nblock], ncol nul-terminated names, the R-serialized attributes
+ *   int64 offset of SnapHead, "DTSNAP\0\1"
+ *
+ * The data of a logical, integer, double, complex or raw column is the vector's memory as it is. A character column is
+ * nrow int32 lengths (NA_INTEGER for NA) followed by the UTF-8 bytes of the strings one after another.
+ * Blocks are the unit of parallel work in both directions: fsave() deflates them in parallel and writes them in order as
+ * fwrite() does with its batches of rows; fload() memory maps the file as fread() does and copies or inflates the blocks
+ * of the selected columns in parallel straight into the result's columns.
+ */
+
+#define SNAP_MAGIC "DTSNAP\0\1"
+#define SNAP_MAGIC_LEN 8
+#define SNAP_BOM 0x01020304
+#define SNAP_BLOCK ((int64_t)1<<24)  // 16MB
+
+typedef struct SnapHead {
+  int64_t nrow;
+  int32_t ncol;
+  int32_t compressed;   // 1 when compress=TRUE; a block is stored deflated only when that made it smaller
+  int64_t nblock;       // total number of blocks of all columns
+  int64_t namesLen;     // bytes of the names including their nul terminators
+  int64_t attrLen;      // bytes of the R-serialized attributes
+} SnapHead;
+
+typedef struct SnapCol {
+  int32_t type;         // SEXPTYPE
+  int32_t nblock;
+  int64_t offset;       // file offset of the column's first block
+  int64_t rawSize;      // bytes of the column's data uncompressed
+  int64_t firstBlock;   // index of the column's first block in blockSize[]
+} SnapCol;
+
+static size_t typeSize(int type)
+{
+  switch(type) {
+  case LGLSXP: case INTSXP: return sizeof(int);
+  case REALSXP: return sizeof(double);
+  case CPLXSXP: return sizeof(Rcomplex);
+  case RAWSXP: return 1;
+  case STRSXP: return 0;
+  default: return SIZE_MAX;
+  }
+}
+
+static inline int64_t blockRawSize(const SnapCol *col, int64_t k)
+{
+  return MIN(SNAP_BLOCK, col->rawSize - k*SNAP_BLOCK);
+}
+
+SEXP fsaveR(SEXP DT, SEXP namesArg, SEXP fileArg, SEXP attrArg, SEXP compressArg, SEXP nThreadArg, SEXP verboseArg)
+{
+  if (!isNewList(DT)) error(_("x must be a list of columns; e.g. data.table or data.frame"));  // # nocov
+  if (!isString(fileArg) || length(fileArg)!=1) error(_("%s must be a single file name"), "file");  // # nocov
+  if (!IS_TRUE_OR_FALSE(compressArg)) error(_("%s must be TRUE or FALSE"), "compress");
+  if (!IS_TRUE_OR_FALSE(verboseArg)) error(_("%s must be TRUE or FALSE"), "verbose");
+  if (TYPEOF(attrArg)!=RAWSXP) error(_("Internal error: attributes must be raw"));  // # nocov
+  if (!isInteger(nThreadArg) || length(nThreadArg)!=1 || INTEGER(nThreadArg)[0]<1) error(_("Internal error: nThread must be a single positive integer"));  // # nocov
+  const bool verbose = LOGICAL(verboseArg)[0];
+  const bool compress = LOGICAL(compressArg)[0];
+#ifdef NOZLIB
+  if (compress) error(_("compress=TRUE uses the zlib library. Its header files were not found at the time data.table was compiled. To enable compression, please reinstall data.table and study the output for further guidance."));  // # nocov
+#endif
+  double tt[4];
+  tt[0] = wallclock();
+  const int ncol = length(DT);
+  const int64_t nrow = ncol ? xlength(VECTOR_ELT(DT, 0)) : 0;
+
+  // Column metadata, and the character columns packed into the layout described above before the parallel region
+  // since they need the R API to convert to UTF-8
+  SnapCol *cols = (SnapCol *)R_alloc(ncol, sizeof(SnapCol));
+  const char **data = (const char **)R_alloc(ncol, sizeof(char *));
+  int64_t nblock=0;
+  for (int j=0; j<ncol; j++) {
+    SEXP col = VECTOR_ELT(DT, j);
+    int type = TYPEOF(col);
+    size_t size = typeSize(type);
+    if (size==SIZE_MAX) error(_("Column %d is type '%s' which is not supported by fsave. Supported types are logical, integer, double, complex, raw and character."), j+1, type2char(type));
+    if (xlength(col)!=nrow) error(_("Column %d is length %"PRId64" but column 1 is length %"PRId64), j+1, (int64_t)xlength(col), nrow);
+    cols[j].type = type;
+    if (type==STRSXP) {
+      const SEXP *xp = SEXPPTR_RO(col);
+      const void *vmax = vmaxget();
+      int64_t nchar=0;
+      for (int64_t i=0; i<nrow; i++) {
+        if (xp[i]!=NA_STRING) nchar += NEED2UTF8(xp[i]) ? strlen(translateCharUTF8(xp[i])) : (size_t)LENGTH(xp[i]);
+      }
+      vmaxset(vmax);  // release the translations before allocating buff below which must stay
+      cols[j].rawSize = nrow*sizeof(int32_t) + nchar;
+      char *buff = R_alloc(cols[j].rawSize, 1);
+      int32_t *len = (int32_t *)buff;
+      char *ch = buff + nrow*sizeof(int32_t);
+      vmax = vmaxget();
+      for (int64_t i=0; i<nrow; i++) {
+        if (xp[i]==NA_STRING) { len[i]=NA_INTEGER; continue; }
+        const bool translate = NEED2UTF8(xp[i]);
+        const char *str = translate ? translateCharUTF8(xp[i]) : CHAR(xp[i]);
+        len[i] = translate ? (int32_t)strlen(str) : LENGTH(xp[i]);
+        memcpy(ch, str, len[i]);
+        ch += len[i];
+      }
+      vmaxset(vmax);
+      data[j] = buff;
+    } else {
+      cols[j].rawSize = nrow*size;
+      data[j] = (const char *)DATAPTR_RO(col);
+    }
+    cols[j].firstBlock = nblock;
+    cols[j].nblock = (cols[j].rawSize + SNAP_BLOCK-1) / SNAP_BLOCK;
+    nblock += cols[j].nblock;
+  }
+  int *blockCol = (int *)R_alloc(nblock, sizeof(int));
+  int64_t *blockSize = (int64_t *)R_alloc(nblock, sizeof(int64_t));
+  for (int j=0; j<ncol; j++) for (int k=0; k<cols[j].nblock; k++) blockCol[cols[j].firstBlock+k] = j;
+  tt[1] = wallclock();
+
+  const char *fnam = CHAR(STRING_ELT(fileArg, 0));
+  FILE *f = fopen(fnam, "wb");
+  if (f==NULL) error(_("%s: '%s'. Unable to create file for writing."), strerror(errno), fnam);
+  const uint32_t bom[2] = {SNAP_BOM, 0};
+  bool failed = fwrite(SNAP_MAGIC, 1, SNAP_MAGIC_LEN, f)!=SNAP_MAGIC_LEN || fwrite(bom, sizeof(bom), 1, f)!=1;
+  int failed_errno = failed ? errno : 0;
+  int failed_compress = 0;
+  int64_t offset = SNAP_MAGIC_LEN + sizeof(bom);
+
+  int nth = getDTthreads(nblock, false);
+  if (INTEGER(nThreadArg)[0]<nth) nth = INTEGER(nThreadArg)[0];
+  if (verbose) Rprintf(_("Writing %d columns of %"PRId64" rows in %"PRId64" blocks using %d threads\n"), ncol, nrow, nblock, nth);
+  #pragma omp parallel num_threads(nth)
+  {
+    char *myBuff = NULL;
+    size_t myBuffSize = 0;
+#ifndef NOZLIB
+    if (compress) {
+      myBuffSize = compressBound(SNAP_BLOCK);
+      myBuff = malloc(myBuffSize);
+      if (!myBuff) failed = true;  // # nocov
+    }
+#endif
+    #pragma omp for ordered schedule(dynamic)
+    for (int64_t b=0; b<nblock; b++) {
+      if (failed) continue;  // Not break. Because we don't use #omp cancel yet.
+      const SnapCol *col = &cols[blockCol[b]];
+      int64_t k = b - col->firstBlock;
+      const char *src = data[blockCol[b]] + k*SNAP_BLOCK;
+      size_t len = blockRawSize(col, k);
+      const char *out = src;
+      size_t outLen = len;
+#ifndef NOZLIB
+      if (compress) {
+        uLongf zlen = myBuffSize;
+        int ret = compress2((Bytef *)myBuff, &zlen, (const Bytef *)src, len, Z_BEST_SPEED);
+        if (ret!=Z_OK) { failed = true; failed_compress = ret; }  // # nocov
+        else if (zlen<len) { out = myBuff; outLen = zlen; }
+      }
+#endif
+      #pragma omp ordered
+      if (!failed) {
+        if (b==col->firstBlock) cols[blockCol[b]].offset = offset;
+        blockSize[b] = outLen;
+        offset += outLen;
+        if (fwrite(out, 1, outLen, f)!=outLen) { failed=true; failed_errno=errno; }  // # nocov
+      }
+    }
+    free(myBuff);
+  }
+  for (int j=0; j<ncol; j++) if (cols[j].nblock==0) cols[j].offset = offset;
+  tt[2] = wallclock();
+
+  // Footer
+  int64_t namesLen = 0;
+  for (int j=0; j<ncol; j++) namesLen += strlen(CHAR(STRING_ELT(namesArg, j)))+1;
+  SnapHead head = {nrow, ncol, compress, nblock, namesLen, xlength(attrArg)};
+  const int64_t footerOffset = offset;
+  if (!failed) {
+    failed = fwrite(&head, sizeof(head), 1, f)!=1 ||
+             (ncol && fwrite(cols, sizeof(SnapCol), ncol, f)!=(size_t)ncol) ||
+             (nblock && fwrite(blockSize, sizeof(int64_t), nblock, f)!=(size_t)nblock);
+    for (int j=0; j<ncol && !failed; j++) {
+      const char *name = CHAR(STRING_ELT(namesArg, j));
+      failed = fwrite(name, 1, strlen(name)+1, f)!=strlen(name)+1;
+    }
+    failed = failed || fwrite(RAW(attrArg), 1, head.attrLen, f)!=(size_t)head.attrLen ||
+             fwrite(&footerOffset, sizeof(footerOffset), 1, f)!=1 ||
+             fwrite(SNAP_MAGIC, 1, SNAP_MAGIC_LEN, f)!=SNAP_MAGIC_LEN;
+    if (failed) failed_errno = errno;  // # nocov
+  }
+  if (fclose(f) && !failed) { failed=true; failed_errno=errno; }  // # nocov
+  if (failed) {
+    // # nocov start
+    remove(fnam);
+#ifndef NOZLIB
+    if (failed_compress) error(_("zlib compress2() returned error %d"), failed_compress);
+#endif
+    error(_("%s: '%s'. Unable to write the file."), strerror(failed_errno), fnam);
+    // # nocov end
+  }
+  tt[3] = wallclock();
+  if (verbose) Rprintf(_("Wrote %"PRId64" bytes. Preparing columns %.3fs, writing column data %.3fs, footer %.3fs\n"),
+                       footerOffset + (int64_t)sizeof(head) + ncol*(int64_t)sizeof(SnapCol) + nblock*8 + namesLen + head.attrLen + 8 + SNAP_MAGIC_LEN,
+                       tt[1]-tt[0], tt[2]-tt[1], tt[3]-tt[2]);
+  return R_NilValue;
+}
+
+static void *mmp = NULL;
+static size_t mmpSize = 0;
+
+static void unmapSnap(void)
+{
+  if (mmp==NULL) return;
+  #ifdef WIN32
+    UnmapViewOfFile(mmp);
+  #else
+    munmap(mmp, mmpSize);
+  #endif
+  mmp = NULL;
+}
+
+// unmap before error() as error() does not return
+#define SNAPSTOP(...) do { unmapSnap(); error(__VA_ARGS__); } while(0)
+
+static void mapSnap(const char *fnam)
+{
+  unmapSnap();  // in case a previous fload() was interrupted
+  #ifndef WIN32
+    int fd = open(fnam, O_RDONLY);
+    if (fd==-1) error(_("File not found: %s"), fnam);
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) == -1) {
+      close(fd);                                                          // # nocov
+      error(_("Opened file ok but couldn't obtain its size: %s"), fnam);  // # nocov
+    }
+    mmpSize = (size_t)stat_buf.st_size;
+    if (mmpSize==0) { close(fd); error(_("File is empty: %s"), fnam); }
+    void *p = mmap(NULL, mmpSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // we don't need to keep file handle open
+    if (p==MAP_FAILED) error(_("Opened file ok but could not memory map it: %s"), fnam);  // # nocov
+    mmp = p;
+  #else
+    HANDLE hFile = CreateFile(fnam, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (hFile==INVALID_HANDLE_VALUE) error(_("Unable to open file (error %d): %s"), GetLastError(), fnam);
+    LARGE_INTEGER liFileSize;
+    if (GetFileSizeEx(hFile,&liFileSize)==0) { CloseHandle(hFile); error(_("GetFileSizeEx failed (returned 0) on file: %s"), fnam); }
+    mmpSize = (size_t)liFileSize.QuadPart;
+    if (mmpSize==0) { CloseHandle(hFile); error(_("File is empty: %s"), fnam); }
+    HANDLE hMap=CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMap==NULL) { CloseHandle(hFile); error(_("This is Windows, CreateFileMapping returned error %d for file %s"), GetLastError(), fnam); }
+    mmp = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, mmpSize);
+    CloseHandle(hMap);  // the MapView keeps an internal reference
+    CloseHandle(hFile);
+    if (mmp==NULL) error(_("Opened file ok but could not memory map it: %s"), fnam);  // # nocov
+  #endif
+}
+
+SEXP floadR(SEXP fileArg, SEXP selectArg, SEXP nThreadArg, SEXP verboseArg)
+{
+  if (!isString(fileArg) || length(fileArg)!=1) error(_("%s must be a single file name"), "file");  // # nocov
+  if (!IS_TRUE_OR_FALSE(verboseArg)) error(_("%s must be TRUE or FALSE"), "verbose");
+  if (!isInteger(nThreadArg) || length(nThreadArg)!=1 || INTEGER(nThreadArg)[0]<1) error(_("Internal error: nThread must be a single positive integer"));  // # nocov
+  const bool verbose = LOGICAL(verboseArg)[0];
+  double tt[4];
+  tt[0] = wallclock();
+  const char *fnam = CHAR(STRING_ELT(fileArg, 0));
+  mapSnap(fnam);
+  const char *sof = (const char *)mmp, *eof = sof + mmpSize;
+
+  // Check the file is a snapshot and that its footer is consistent, before trusting any size or offset in it
+  const size_t minSize = SNAP_MAGIC_LEN + 8 + sizeof(SnapHead) + 8 + SNAP_MAGIC_LEN;
+  if (mmpSize<minSize || memcmp(sof, SNAP_MAGIC, SNAP_MAGIC_LEN) || memcmp(eof-SNAP_MAGIC_LEN, SNAP_MAGIC, SNAP_MAGIC_LEN))
+    SNAPSTOP(_("File '%s' is not a file written by fsave(), or it has been truncated."), fnam);
+  uint32_t bom;
+  memcpy(&bom, sof+SNAP_MAGIC_LEN, sizeof(bom));
+  if (bom!=SNAP_BOM) SNAPSTOP(_("File '%s' was written by fsave() on a machine with a different byte order."), fnam);
+  int64_t footerOffset;
+  memcpy(&footerOffset, eof-SNAP_MAGIC_LEN-8, 8);
+  const int64_t footerEnd = mmpSize-SNAP_MAGIC_LEN-8;
+  SnapHead head;
+  if (footerOffset<SNAP_MAGIC_LEN+8 || footerOffset+(int64_t)sizeof(head)>footerEnd)
+    SNAPSTOP(_("File '%s' has an invalid footer. It is corrupt or was not written by fsave()."), fnam);
+  memcpy(&head, sof+footerOffset, sizeof(head));
+  const int ncol = head.ncol;
+  const int64_t nrow = head.nrow;
+  if (ncol<0 || nrow<0 || head.nblock<0 || head.namesLen<0 || head.attrLen<0 ||
+      footerOffset + (int64_t)sizeof(head) + ncol*(int64_t)sizeof(SnapCol) + head.nblock*8 + head.namesLen + head.attrLen != footerEnd)
+    SNAPSTOP(_("File '%s' has an invalid footer. It is corrupt or was not written by fsave()."), fnam);
+  const SnapCol *cols = (const SnapCol *)(sof + footerOffset + sizeof(head));
+  const int64_t *blockSize = (const int64_t *)((const char *)cols + ncol*sizeof(SnapCol));
+  const char *names = (const char *)(blockSize + head.nblock);
+  const char *attr = names + head.namesLen;
+  // the footer follows column data of arbitrary length, so cols and blockSize are not necessarily aligned; copy them
+  SnapCol *col = (SnapCol *)R_alloc(ncol, sizeof(SnapCol));
+  int64_t *bsize = (int64_t *)R_alloc(head.nblock, sizeof(int64_t));
+  memcpy(col, cols, ncol*sizeof(SnapCol));
+  memcpy(bsize, blockSize, head.nblock*sizeof(int64_t));
+  for (int j=0; j<ncol; j++) {
+    size_t size = typeSize(col[j].type);
+    if (size==SIZE_MAX || (size && col[j].rawSize!=nrow*(int64_t)size) || (!size && col[j].rawSize<nrow*(int64_t)sizeof(int32_t)) ||
+        col[j].nblock != (col[j].rawSize+SNAP_BLOCK-1)/SNAP_BLOCK || col[j].firstBlock<0 || col[j].firstBlock+col[j].nblock>head.nblock ||
+        col[j].offset<SNAP_MAGIC_LEN+8 || col[j].offset>footerOffset)
+      SNAPSTOP(_("File '%s' has invalid metadata for column %d. It is corrupt or was not written by fsave()."), fnam, j+1);
+    int64_t stored = 0;
+    for (int k=0; k<col[j].nblock; k++) {
+      int64_t s = bsize[col[j].firstBlock+k];
+      if (s<=0 || s>blockRawSize(&col[j], k)) SNAPSTOP(_("File '%s' has invalid metadata for column %d. It is corrupt or was not written by fsave()."), fnam, j+1);
+      stored += s;
+    }
+    if (col[j].offset+stored>footerOffset) SNAPSTOP(_("File '%s' has invalid metadata for column %d. It is corrupt or was not written by fsave()."), fnam, j+1);
+  }
+
+  int nprotect=0;
+  SEXP nameSxp = PROTECT(allocVector(STRSXP, ncol)); nprotect++;
+  const char *ch = names;
+  for (int j=0; j<ncol; j++) {
+    const char *end = memchr(ch, '\0', attr-ch);
+    if (end==NULL) SNAPSTOP(_("File '%s' has invalid column names. It is corrupt or was not written by fsave()."), fnam);
+    SET_STRING_ELT(nameSxp, j, mkCharLenCE(ch, end-ch, CE_UTF8));
+    ch = end+1;
+  }
+
+  // select= as column names or numbers
+  SEXP selSxp;
+  if (isNull(selectArg)) {
+    selSxp = PROTECT(allocVector(INTSXP, ncol)); nprotect++;
+    for (int j=0; j<ncol; j++) INTEGER(selSxp)[j] = j+1;
+  } else if (isString(selectArg)) {
+    selSxp = PROTECT(chmatch(selectArg, nameSxp, NA_INTEGER)); nprotect++;
+    for (int i=0; i<length(selSxp); i++) if (INTEGER(selSxp)[i]==NA_INTEGER)
+      SNAPSTOP(_("Column name '%s' in select= not found in file '%s'"), CHAR(STRING_ELT(selectArg, i)), fnam);
+  } else if (isInteger(selectArg)) {
+    selSxp = selectArg;
+    for (int i=0; i<length(selSxp); i++) if (INTEGER(selSxp)[i]==NA_INTEGER || INTEGER(selSxp)[i]<1 || INTEGER(selSxp)[i]>ncol)
+      SNAPSTOP(_("select= contains column number %d but the file has %d columns"), INTEGER(selSxp)[i], ncol);
+  } else {
+    SNAPSTOP(_("select= must be a character vector of column names or an integer vector of column numbers"));  // # nocov; checked at R level
+  }
+  const int nsel = length(selSxp);
+  const int *sel = INTEGER(selSxp);
+
+  // Allocate the result columns, and for each block of a selected column where it goes
+  SEXP ans = PROTECT(allocVector(VECSXP, nsel)); nprotect++;
+  SEXP ansNames = PROTECT(allocVector(STRSXP, nsel)); nprotect++;
+  char **dest = (char **)R_alloc(nsel, sizeof(char *));
+  int64_t nblock = 0;
+  for (int i=0; i<nsel; i++) {
+    const SnapCol *c = &col[sel[i]-1];
+    SET_VECTOR_ELT(ans, i, allocVector(c->type, nrow));
+    SET_STRING_ELT(ansNames, i, STRING_ELT(nameSxp, sel[i]-1));
+    // character columns are first unpacked to a scratch buffer
+    dest[i] = c->type==STRSXP ? R_alloc(c->rawSize, 1) : (char *)DATAPTR(VECTOR_ELT(ans, i));
+    nblock += c->nblock;
+  }
+  int *blockSel = (int *)R_alloc(nblock, sizeof(int));
+  int *blockK = (int *)R_alloc(nblock, sizeof(int));
+  const char **blockSrc = (const char **)R_alloc(nblock, sizeof(char *));
+  nblock = 0;
+  for (int i=0; i<nsel; i++) {
+    const SnapCol *c = &col[sel[i]-1];
+    const char *src = sof + c->offset;
+    for (int k=0; k<c->nblock; k++) {
+      blockSel[nblock] = i;
+      blockK[nblock] = k;
+      blockSrc[nblock] = src;
+      src += bsize[c->firstBlock+k];
+      nblock++;
+    }
+  }
+  tt[1] = wallclock();
+
+  int nth = getDTthreads(nblock, false);
+  if (INTEGER(nThreadArg)[0]<nth) nth = INTEGER(nThreadArg)[0];
+  if (verbose) Rprintf(_("Reading %d of %d columns of %"PRId64" rows in %"PRId64" blocks using %d threads\n"), nsel, ncol, nrow, nblock, nth);
+  bool failed = false;
+  #pragma omp parallel for schedule(dynamic) num_threads(nth)
+  for (int64_t b=0; b<nblock; b++) {
+    if (failed) continue;
+    const SnapCol *c = &col[sel[blockSel[b]]-1];
+    const int k = blockK[b];
+    const int64_t raw = blockRawSize(c, k), stored = bsize[c->firstBlock+k];
+    char *to = dest[blockSel[b]] + k*SNAP_BLOCK;
+    if (stored==raw) {
+      memcpy(to, blockSrc[b], raw);
+    } else {
+#ifndef NOZLIB
+      uLongf len = raw;
+      if (uncompress((Bytef *)to, &len, (const Bytef *)blockSrc[b], stored)!=Z_OK || len!=(uLongf)raw) failed = true;
+#else
+      failed = true;  // # nocov
+#endif
+    }
+  }
+  if (failed) {
+#ifdef NOZLIB
+    SNAPSTOP(_("File '%s' is compressed but zlib header files were not found at the time data.table was compiled."), fnam);  // # nocov
+#endif
+    SNAPSTOP(_("File '%s' has a compressed block that could not be inflated. It is corrupt."), fnam);
+  }
+  tt[2] = wallclock();
+
+  // Character columns: the strings are created in R's global string cache one at a time
+  for (int i=0; i<nsel; i++) {
+    if (col[sel[i]-1].type!=STRSXP) continue;
+    const int32_t *len = (const int32_t *)dest[i];
+    const char *s = dest[i] + nrow*sizeof(int32_t), *end = dest[i] + col[sel[i]-1].rawSize;
+    SEXP x = VECTOR_ELT(ans, i);
+    for (int64_t r=0; r<nrow; r++) {
+      int32_t l = len[r];  // dest is R_alloc'd so is aligned
+      if (l==NA_INTEGER) { SET_STRING_ELT(x, r, NA_STRING); continue; }
+      if (l<0 || l>end-s) SNAPSTOP(_("File '%s' has invalid string lengths in column %d. It is corrupt."), fnam, sel[i]);
+      SET_STRING_ELT(x, r, mkCharLenCE(s, l, CE_UTF8));
+      s += l;
+    }
+  }
+  SEXP attrSxp = PROTECT(allocVector(RAWSXP, head.attrLen)); nprotect++;
+  memcpy(RAW(attrSxp), attr, head.attrLen);
+  unmapSnap();
+  setAttrib(ans, R_NamesSymbol, ansNames);
+  tt[3] = wallclock();
+  if (verbose) Rprintf(_("Mapping and checking the file %.3fs, column data %.3fs, strings %.3fs\n"), tt[1]-tt[0], tt[2]-tt[1], tt[3]-tt[2]);
+
+  SEXP ret = PROTECT(allocVector(VECSXP, 4)); nprotect++;  // the columns, their attributes, which columns, and nrow for when no columns are selected
+  SET_VECTOR_ELT(ret, 0, ans);
+  SET_VECTOR_ELT(ret, 1, attrSxp);
+  SET_VECTOR_ELT(ret, 2, selSxp);
+  SET_VECTOR_ELT(ret, 3, ScalarReal((double)nrow));
+  UNPROTECT(nprotect);
+  return ret;
+}
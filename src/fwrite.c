@@ -10,20 +10,28 @@
 #ifndef NOZLIB
 #include <zlib.h>      // for compression to .gz
 #endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>      // for compression to .zst; only when installed with PKG_CFLAGS=-DHAVE_ZSTD PKG_LIBS=-lzstd
+#include <zstd_errors.h>
+#endif
 
 #ifdef WIN32
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <io.h>
+#include <windows.h>   // SwitchToThread, Sleep
 #define WRITE _write
 #define CLOSE _close
 #else
+#include <sched.h>     // sched_yield
+#include <time.h>      // nanosleep
 #define WRITE write
 #define CLOSE close
 #endif
 
 #include "myomp.h"
 #include "fwriteLookups.h"
+#include "fwriteRyu.h"
 #include "fwrite.h"
 
 #define NUM_SF   15
@@ -42,14 +50,22 @@ static int8_t doQuote=INT8_MIN;        // whether to surround fields with double
 static bool qmethodEscape=false;       // when quoting fields, how to escape double quotes in the field contents (default false means to add another double quote)
 static int scipen;
 static bool squashDateTime=false;      // 0=ISO(yyyy-mm-dd) 1=squash(yyyymmdd)
+static bool roundtrip=false;           // write doubles with the fewest digits that read back exactly, rather than 15 s.f.
 static bool verbose=false;
+static int compressLevel=6;            // zlib's level and memLevel when is_gzip; zstd's level when is_zstd
+static int compressMemLevel=8;
+static bool compressed=false;          // is_gzip || is_zstd: each batch is compressed into its slot's zbuff and written from there
+static MemSink *mem=NULL;              // not NULL when writing to memory rather than to a file
 
 extern const char *getString(const void *, int64_t);
 extern int getStringLen(const void *, int64_t);
-extern int getMaxStringLen(const void *, int64_t);
+extern int getMaxStringLen(const void *, int64_t, const char *, int, bool *);
 extern int getMaxCategLen(const void *);
 extern int getMaxListItemLen(const void *, int64_t);
 extern const char *getCategString(const void *, int64_t);
+extern int getCategNLevels(const void *);
+extern const char *getCategLevel(const void *, int);
+extern const int32_t *getCategCodes(const void *);
 extern double wallclock(void);
 
 inline void write_chars(const char *x, char **pch)
@@ -177,6 +193,132 @@ void genLookups() {
 }
 */
 
+/*
+ * Shortest round trip digits, for fwrite(..., roundtrip=TRUE).
+ * This is Ryu (Ulf Adams, "Ryu: fast float-to-string conversion", PLDI 2018) in integer arithmetic only. Of all the decimals
+ * that read back as this double, it finds the one with the fewest digits and, of those, the closest to the double. Up to 17
+ * digits are needed (15 are not enough for most doubles) and neither long double nor __int128 is needed.
+ */
+static inline int pow5bits(int e)  { return (int)(((uint32_t)e * 1217359) >> 19) + 1; }  // ceil(log2(5^e)) for e in [1,3528]
+static inline int log10Pow2(int e) { return (int)(((uint32_t)e * 78913) >> 18); }        // floor(log10(2^e)) for e in [0,1650]
+static inline int log10Pow5(int e) { return (int)(((uint32_t)e * 732923) >> 20); }       // floor(log10(5^e)) for e in [0,2620]
+
+static inline bool multipleOfPowerOf5(uint64_t v, int p)
+{
+  int count = 0;
+  while (v%5 == 0) { v /= 5; count++; }
+  return count >= p;
+}
+
+static inline uint64_t umul128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+  // the 128 bit product of a and b; returns the low 64 bits and sets *hi to the high 64 bits
+  uint64_t aLo=(uint32_t)a, aHi=a>>32, bLo=(uint32_t)b, bHi=b>>32;
+  uint64_t b00=aLo*bLo, b01=aLo*bHi, b10=aHi*bLo, b11=aHi*bHi;
+  uint64_t mid1 = b10 + (b00>>32);
+  uint64_t mid2 = b01 + (uint32_t)mid1;
+  *hi = b11 + (mid1>>32) + (mid2>>32);
+  return (mid2<<32) | (uint32_t)b00;
+}
+
+static inline uint64_t mulShift(uint64_t m, const uint64_t *mul, int j)
+{
+  // (m * mul) >> j where mul is the 128 bit {low,high} and j is in (64,128)
+  uint64_t high0, high1;
+  uint64_t low1 = umul128(m, mul[1], &high1);
+  umul128(m, mul[0], &high0);
+  uint64_t sum = high0 + low1;
+  if (sum < high0) high1++;
+  return (high1 << (128-j)) | (sum >> (j-64));
+}
+
+static int shortestDigits(uint64_t bits, uint64_t *digits)
+{
+  // bits is a finite positive double. Sets *digits and returns e10 such that the double is read back from *digits x 10^e10
+  const uint64_t ieeeMantissa = bits & 0xFFFFFFFFFFFFF;
+  const int ieeeExponent = (int)((bits>>52) & 0x7FF);
+  int e2;
+  uint64_t m2;
+  if (ieeeExponent==0) { e2 = 1-1023-52-2; m2 = ieeeMantissa; }  // subnormal
+  else { e2 = ieeeExponent-1023-52-2; m2 = (1ULL<<52) | ieeeMantissa; }
+  // the double is mv x 2^e2 and any decimal strictly between mm and mp (or on them when m2 is even) reads back as it
+  const bool acceptBounds = (m2&1)==0;
+  const uint64_t mv = 4*m2;
+  const int mmShift = ieeeMantissa!=0 || ieeeExponent<=1;  // the gap below is half the gap above at powers of 2
+  uint64_t vr, vp, vm;  // mv, mp and mm scaled to decimal: x 2^e2 / 10^e10
+  int e10;
+  bool vmIsTrailingZeros=false, vrIsTrailingZeros=false;
+  if (e2>=0) {
+    const int q = log10Pow2(e2) - (e2>3);
+    e10 = q;
+    const int i = -e2 + q + 125 + pow5bits(q) - 1;
+    vr = mulShift(mv, pow5invsplit[q], i);
+    vp = mulShift(mv+2, pow5invsplit[q], i);
+    vm = mulShift(mv-1-mmShift, pow5invsplit[q], i);
+    if (q<=21) {
+      // only one of mp, mv and mm can be a multiple of 5, if any
+      if (mv%5==0) vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+      else if (acceptBounds) vmIsTrailingZeros = multipleOfPowerOf5(mv-1-mmShift, q);
+      else vp -= multipleOfPowerOf5(mv+2, q);
+    }
+  } else {
+    const int q = log10Pow5(-e2) - (-e2>1);
+    e10 = q + e2;
+    const int i = -e2 - q;
+    const int j = q - (pow5bits(i) - 125);
+    vr = mulShift(mv, pow5split[i], j);
+    vp = mulShift(mv+2, pow5split[i], j);
+    vm = mulShift(mv-1-mmShift, pow5split[i], j);
+    if (q<=1) {
+      // mv has at least q trailing 0 bits, and so do mp and mm when they are even
+      vrIsTrailingZeros = true;
+      if (acceptBounds) vmIsTrailingZeros = mmShift==1;
+      else vp--;
+    } else if (q<63) {
+      vrIsTrailingZeros = (mv & ((1ULL<<q)-1)) == 0;
+    }
+  }
+  // remove digits while vp and vm still differ in what remains, and round vr at the last removed digit
+  int removed = 0;
+  int lastRemovedDigit = 0;
+  uint64_t output;
+  if (vmIsTrailingZeros || vrIsTrailingZeros) {
+    // rare; exact ties and the closed interval need the digits removed to be tracked exactly
+    while (vp/10 > vm/10) {
+      vmIsTrailingZeros &= vm%10==0;
+      vrIsTrailingZeros &= lastRemovedDigit==0;
+      lastRemovedDigit = vr%10;
+      vr/=10; vp/=10; vm/=10;
+      removed++;
+    }
+    if (vmIsTrailingZeros) {
+      while (vm%10==0) {
+        vrIsTrailingZeros &= lastRemovedDigit==0;
+        lastRemovedDigit = vr%10;
+        vr/=10; vp/=10; vm/=10;
+        removed++;
+      }
+    }
+    if (vrIsTrailingZeros && lastRemovedDigit==5 && vr%2==0) lastRemovedDigit = 4;  // exactly half way: round to even
+    output = vr + ((vr==vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit>=5);
+  } else {
+    bool roundUp = false;
+    if (vp/100 > vm/100) {  // two digits at a time first, which is most of them for doubles with 15+ s.f.
+      roundUp = vr%100 >= 50;
+      vr/=100; vp/=100; vm/=100;
+      removed += 2;
+    }
+    while (vp/10 > vm/10) {
+      roundUp = vr%10 >= 5;
+      vr/=10; vp/=10; vm/=10;
+      removed++;
+    }
+    output = vr + (vr==vm || roundUp);
+  }
+  *digits = output;
+  return e10 + removed;
+}
+
 void writeFloat64(double *col, int64_t row, char **pch)
 {
   // hand-rolled / specialized for speed
@@ -202,50 +344,61 @@ void writeFloat64(double *col, int64_t row, char **pch)
     if (x < 0.0) { *ch++ = '-'; x = -x; }  // and we're done on sign, already written. no need to pass back sign
     union { double d; uint64_t l; } u;
     u.d = x;
-    uint64_t fraction = u.l & 0xFFFFFFFFFFFFF;           // (1<<52)-1;
-    uint32_t exponent = (int32_t)((u.l>>52) & 0x7FF);    // [0,2047]
-
-    // Now sum the appropriate powers 2^-(1:52) of the fraction
-    // Important for accuracy to start with the smallest first; i.e. 2^-52
-    // Exact powers of 2 (1.0, 2.0, 4.0, etc) are represented precisely with fraction==0
-    // Skip over tailing zeros for exactly representable numbers such 0.5, 0.75
-    // Underflow here (0u-1u = all 1s) is on an unsigned type which is ok by C standards
-    // sigparts[0] arranged to be 0.0 in genLookups() to enable branch free loop here
-    double acc = 0;  // 'long double' not needed
-    int i = 52;
-    if (fraction) {
-      while ((fraction & 0xFF) == 0) { fraction >>= 8; i-=8; }
-      while (fraction) {
-        acc += sigparts[(((fraction & 1u)^1u)-1u) & i];
-        i--;
-        fraction >>= 1;
+    uint64_t l;
+    int exp, sf=0;  // sf stays 0 when l rounds to 0
+    if (roundtrip) {
+      exp = shortestDigits(u.l, &l);
+      while (l%10 == 0) { l /= 10; exp++; }
+      sf = 1;
+      for (uint64_t p=10; p<=l; p*=10) sf++;  // l < 10^17 so p cannot overflow
+      exp += sf-1;
+    } else {
+      uint64_t fraction = u.l & 0xFFFFFFFFFFFFF;           // (1<<52)-1;
+      uint32_t exponent = (int32_t)((u.l>>52) & 0x7FF);    // [0,2047]
+
+      // Now sum the appropriate powers 2^-(1:52) of the fraction
+      // Important for accuracy to start with the smallest first; i.e. 2^-52
+      // Exact powers of 2 (1.0, 2.0, 4.0, etc) are represented precisely with fraction==0
+      // Skip over tailing zeros for exactly representable numbers such 0.5, 0.75
+      // Underflow here (0u-1u = all 1s) is on an unsigned type which is ok by C standards
+      // sigparts[0] arranged to be 0.0 in genLookups() to enable branch free loop here
+      double acc = 0;  // 'long double' not needed
+      int i = 52;
+      if (fraction) {
+        while ((fraction & 0xFF) == 0) { fraction >>= 8; i-=8; }
+        while (fraction) {
+          acc += sigparts[(((fraction & 1u)^1u)-1u) & i];
+          i--;
+          fraction >>= 1;
+        }
+      }
+      // 1.0+acc is in range [1.5,2.0) by IEEE754
+      // expsig is in range [1.0,10.0) by design of fwriteLookups.h
+      // Therefore y in range [1.5,20.0)
+      // Avoids (potentially inaccurate and potentially slow) log10/log10l, pow/powl, ldexp/ldexpl
+      // By design we can just lookup the power from the tables
+      double y = (1.0+acc) * expsig[exponent];  // low magnitude mult
+      exp = exppow[exponent];
+      if (y>=9.99999999999999) { y /= 10; exp++; }
+      l = y * SIZE_SF;  // low magnitude mult 10^NUM_SF
+      // l now contains NUM_SF+1 digits as integer where repeated /10 below is accurate
+
+      // if (verbose) Rprintf(_("\nTRACE: acc=%.20Le ; y=%.20Le ; l=%"PRIu64" ; e=%d     "), acc, y, l, exp);
+
+      if (l%10 >= 5) l+=10; // use the last digit to round
+      l /= 10;
+      if (l) {
+        // Count trailing zeros and therefore s.f. present in l
+        int trailZero = 0;
+        while (l%10 == 0) { l /= 10; trailZero++; }
+        sf = NUM_SF - trailZero;
+        if (sf==0) {sf=1; exp++;}  // e.g. l was 9999999[5-9] rounded to 10000000 which added 1 digit
       }
     }
-    // 1.0+acc is in range [1.5,2.0) by IEEE754
-    // expsig is in range [1.0,10.0) by design of fwriteLookups.h
-    // Therefore y in range [1.5,20.0)
-    // Avoids (potentially inaccurate and potentially slow) log10/log10l, pow/powl, ldexp/ldexpl
-    // By design we can just lookup the power from the tables
-    double y = (1.0+acc) * expsig[exponent];  // low magnitude mult
-    int exp = exppow[exponent];
-    if (y>=9.99999999999999) { y /= 10; exp++; }
-    uint64_t l = y * SIZE_SF;  // low magnitude mult 10^NUM_SF
-    // l now contains NUM_SF+1 digits as integer where repeated /10 below is accurate
-
-    // if (verbose) Rprintf(_("\nTRACE: acc=%.20Le ; y=%.20Le ; l=%"PRIu64" ; e=%d     "), acc, y, l, exp);
-
-    if (l%10 >= 5) l+=10; // use the last digit to round
-    l /= 10;
-    if (l == 0) {
+    if (sf == 0) {
       if (*(ch-1)=='-') ch--;
       *ch++ = '0';
     } else {
-      // Count trailing zeros and therefore s.f. present in l
-      int trailZero = 0;
-      while (l%10 == 0) { l /= 10; trailZero++; }
-      int sf = NUM_SF - trailZero;
-      if (sf==0) {sf=1; exp++;}  // e.g. l was 9999999[5-9] rounded to 10000000 which added 1 digit
-
       // l is now an unsigned long that doesn't start or end with 0
       // sf is the number of digits now in l
       // exp is e<exp> were l to be written with the decimal sep after the first digit
@@ -547,6 +700,22 @@ static inline void write_string(const char *x, char **pch)
   *pch = ch;
 }
 
+// x is known to contain no sep, sep2, newline or quote (nor backslash when escaping), so only NA and "" need care
+static inline void write_plain_string(const char *x, char **pch)
+{
+  char *ch = *pch;
+  if (x == NULL) {
+    write_chars(na, &ch);
+  } else if (doQuote==1 || (doQuote==INT8_MIN && *x=='\0')) {
+    *ch++ = '"';
+    write_chars(x, &ch);
+    *ch++ = '"';
+  } else {
+    write_chars(x, &ch);
+  }
+  *pch = ch;
+}
+
 void writeString(const void *col, int64_t row, char **pch)
 {
   write_string(getString(col, row), pch);
@@ -557,6 +726,47 @@ void writeCategString(const void *col, int64_t row, char **pch)
   write_string(getCategString(col, row), pch);
 }
 
+// Batch writers format a run of n rows of one column into consecutive fixed-width slots of a thread's scratch area
+// and record each field's length. The cell writer is called directly here, so there is one indirect call per column
+// per run rather than one per cell, and the compiler can inline the formatting into the loop.
+// Only the fixed-width writers (writerMaxLen>0) have one; strings, factors and lists are still written cell by cell.
+// rows, when not NULL, holds the (1-based) row numbers to write in place of from, from+1, ...; see partRows in fwrite.h
+typedef void (*batch_fun_t)(const void *col, int64_t from, const int32_t *rows, int n, char *slot, int width, int *len);
+
+#define BATCH_WRITER(fun, type)                                                                     \
+static void fun##Batch(const void *col, int64_t from, const int32_t *rows, int n, char *slot,      \
+                       int width, int *len)                                                         \
+{                                                                                                   \
+  for (int k=0; k<n; k++, slot+=width) {                                                            \
+    char *ch = slot;                                                                                \
+    fun((type *)col, rows ? rows[from+k]-1 : from+k, &ch);                                          \
+    len[k] = (int)(ch-slot);                                                                        \
+  }                                                                                                 \
+}
+BATCH_WRITER(writeBool8, int8_t)
+BATCH_WRITER(writeBool32, int32_t)
+BATCH_WRITER(writeBool32AsString, int32_t)
+BATCH_WRITER(writeInt32, int32_t)
+BATCH_WRITER(writeInt64, int64_t)
+BATCH_WRITER(writeFloat64, double)
+BATCH_WRITER(writeComplex, Rcomplex)
+BATCH_WRITER(writeITime, int32_t)
+BATCH_WRITER(writeDateInt32, int32_t)
+BATCH_WRITER(writeDateFloat64, double)
+BATCH_WRITER(writePOSIXct, double)
+BATCH_WRITER(writeNanotime, int64_t)
+
+static const batch_fun_t batchFuns[] = {  // same order as WFs in fwrite.h
+  writeBool8Batch, writeBool32Batch, writeBool32AsStringBatch, writeInt32Batch, writeInt64Batch, writeFloat64Batch,
+  writeComplexBatch, writeITimeBatch, writeDateInt32Batch, writeDateFloat64Batch, writePOSIXctBatch, writeNanotimeBatch,
+  NULL, NULL, NULL  // String, CategString, List
+};
+static const writer_fun_t cellFuns[] = {  // to confirm args.funs[] is the standard set before using batchFuns[] in its place
+  (writer_fun_t)writeBool8, (writer_fun_t)writeBool32, (writer_fun_t)writeBool32AsString, (writer_fun_t)writeInt32,
+  (writer_fun_t)writeInt64, (writer_fun_t)writeFloat64, (writer_fun_t)writeComplex, (writer_fun_t)writeITime,
+  (writer_fun_t)writeDateInt32, (writer_fun_t)writeDateFloat64, (writer_fun_t)writePOSIXct, (writer_fun_t)writeNanotime
+};
+
 #ifndef NOZLIB
 int init_stream(z_stream *stream) {
   memset(stream, 0, sizeof(z_stream)); // shouldn't be needed, done as part of #4099 to be sure
@@ -566,7 +776,7 @@ int init_stream(z_stream *stream) {
   stream->opaque = Z_NULL;
 
   // 31 comes from : windows bits 15 | 16 gzip format
-  int err = deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+  int err = deflateInit2(stream, compressLevel, Z_DEFLATED, 31, compressMemLevel, Z_DEFAULT_STRATEGY);
   return err;  // # nocov
 }
 
@@ -586,6 +796,303 @@ int compressbuff(z_stream *stream, void* dest, size_t *destLen, const void* sour
 }
 #endif
 
+// Compress sourceLen bytes into dest as one gzip member through the thread's z_stream, or one zstd frame through its
+// ZSTD_CCtx; a file of such members or frames one after another decompresses as a single stream. *destLen is the room in
+// dest and is set to the bytes used. Returns 0, or zlib's or (negated) zstd's error code.
+static int zcompress(bool zstd, void *stream, void *dest, size_t *destLen, const void *source, size_t sourceLen)
+{
+#ifdef HAVE_ZSTD
+  if (zstd) {
+    const size_t n = ZSTD_compressCCtx(stream, dest, *destLen, source, sourceLen, compressLevel);
+    if (ZSTD_isError(n)) return -(int)ZSTD_getErrorCode(n);  // # nocov
+    *destLen = n;
+    return 0;
+  }
+#endif
+#ifndef NOZLIB
+  if (!zstd) {
+    int ret = compressbuff(stream, dest, destLen, source, sourceLen);
+    if (!ret) deflateReset(stream);
+    return ret;
+  }
+#endif
+  return -999;  // # nocov; fwriteMain stops first when the library was not compiled in
+}
+
+// Layout of each thread's scratch for the batch writers, set in fwriteMain
+static int *batchWidth=NULL;   // slot width of column j's batch writer, or 0 when column j is written cell by cell
+static size_t *batchOff=NULL;  // where column j's slots start in the scratch
+static int runRows=1;          // rows formatted per call to a batch writer
+
+// One buffer of the ring between the formatting threads and the writer
+typedef struct RingSlot {
+  char *buff;     // the rows formatted as text
+  char *zbuff;    // those rows compressed, when gzip or zstd
+  size_t used;    // bytes of buff used
+  size_t zused;   // bytes of zbuff used
+  int64_t batch;  // the batch ready to be written, -1 initially; set by a formatting thread and read by the writer with omp atomic
+} RingSlot;
+
+// Factor columns are written by copying each level as write_string() would write it, quoted and escaped once up front
+// rather than for every row
+typedef struct CategLevels {
+  const int32_t *codes;  // the factor's codes: 1-based and INT32_MIN for NA
+  char *bytes;           // each level as written one after another, then na, then 8 bytes of padding
+  size_t *off;           // level k (0-based) is bytes[off[k]] up to bytes[off[k+1]]; k==nlevel is na
+  int nlevel;
+} CategLevels;
+static CategLevels *categ=NULL;  // ncol; categ[j].bytes==NULL when column j is written cell by cell
+
+// String columns in which no field contains a character that write_string() looks for (to decide whether to quote the
+// field, or to escape within the quotes) are written without looking for them again in every field
+static bool *plainString=NULL;   // ncol; found in parallel up front along with the longest string
+
+static bool initCategLevels(const void *col, CategLevels *c)
+{
+  int n = getCategNLevels(col);
+  size_t size = strlen(na) + 8;
+  for (int k=0; k<n; k++) size += 2*strlen(getCategLevel(col, k)) + 2;  // as maxLineLen, in case all are quotes
+  c->bytes = malloc(size);
+  c->off = malloc((n+2)*sizeof(size_t));
+  if (!c->bytes || !c->off) {
+    free(c->bytes); free(c->off); c->bytes=NULL; c->off=NULL;  // # nocov
+    return false;                                              // # nocov
+  }
+  char *ch = c->bytes;
+  for (int k=0; k<n; k++) {
+    c->off[k] = ch - c->bytes;
+    write_string(getCategLevel(col, k), &ch);
+  }
+  c->off[n] = ch - c->bytes;
+  write_string(NULL, &ch);
+  c->off[n+1] = ch - c->bytes;
+  c->codes = getCategCodes(col);
+  c->nlevel = n;
+  return true;
+}
+
+static void freeCategLevels(int ncol)
+{
+  if (!categ) return;
+  for (int j=0; j<ncol; j++) { free(categ[j].bytes); free(categ[j].off); }
+  free(categ);
+  categ = NULL;
+}
+
+// Format rows [start,end), or partRows[start,end) when partitioned, into slot->buff and then compress them into slot->zbuff when gzip or zstd, adding the time taken to
+// *tFormat and *tCompress. Returns 0 or zlib's error.
+static int formatBatch(const fwriteMainArgs *args, int64_t start, int64_t end, RingSlot *slot, size_t zbuffSize,
+                       char *myScratch, int *myLen, void *stream, double *tFormat, double *tCompress)
+{
+  double t0 = wallclock();
+  char *ch = slot->buff;
+  for (int64_t run=start; run<end; run+=runRows) {
+    int n = (end-run)<runRows ? (int)(end-run) : runRows;
+    // Format the run's fixed-width fields column by column
+    for (int j=0; j<args->ncol; j++) {
+      if (batchWidth[j]) batchFuns[args->whichFun[j]](args->columns[j], run, args->partRows, n, myScratch+batchOff[j], batchWidth[j], myLen+(size_t)j*runRows);
+    }
+    for (int k=0; k<n; k++) {
+      int64_t i = args->partRows ? args->partRows[run+k]-1 : run+k;
+      // Tepid starts here (once at beginning of each line)
+      if (args->doRowNames) {
+        if (args->rowNames==NULL) {
+          if (doQuote==1) *ch++='"';
+          int64_t rn = i+1;
+          writeInt64(&rn, 0, &ch);
+          if (doQuote==1) *ch++='"';
+        } else {
+          if (args->rowNameFun != WF_String && doQuote==1) *ch++='"';
+          (args->funs[args->rowNameFun])(args->rowNames, i, &ch);  // #5098
+          if (args->rowNameFun != WF_String && doQuote==1) *ch++='"';
+        }
+        *ch = sep;
+        ch += sepLen;
+      }
+      // Hot loop: copy the fields already formatted in the scratch, write the others
+      for (int j=0; j<args->ncol; j++) {
+        if (batchWidth[j]) {
+          const char *field = myScratch+batchOff[j]+(size_t)k*batchWidth[j];
+          int len = myLen[(size_t)j*runRows+k];
+          // 8 bytes at a time; a fixed size memcpy compiles to a single move whereas a variable one is a library call.
+          // The few bytes copied beyond the field are overwritten by what follows, and the line has room for them since
+          // maxLineLen allows each field twice its width.
+          for (int c=0; c<len; c+=8) memcpy(ch+c, field+c, 8);
+          ch += len;
+        } else if (plainString[j]) {
+          write_plain_string(getString(args->columns[j], i), &ch);
+        } else if (categ[j].bytes) {
+          const CategLevels *cl = categ+j;
+          int32_t x = cl->codes[i];
+          int lev = x==INT32_MIN ? cl->nlevel : x-1;
+          const char *field = cl->bytes + cl->off[lev];
+          int len = cl->off[lev+1] - cl->off[lev];
+          for (int c=0; c<len; c+=8) memcpy(ch+c, field+c, 8);  // as above; maxLineLen has room for this too
+          ch += len;
+        } else {
+          (args->funs[args->whichFun[j]])(args->columns[j], i, &ch);
+        }
+        *ch = sep;
+        ch += sepLen;
+      }
+      // Tepid again (once at the end of each line)
+      ch -= sepLen;  // backup onto the last sep after the last column. ncol>=1 because 0-columns was caught earlier.
+      write_chars(args->eol, &ch);  // overwrite last sep with eol instead
+    }
+  }
+  slot->used = ch - slot->buff;
+  double t1 = wallclock();
+  *tFormat += t1-t0;
+  int ret = 0;
+  if (compressed) {
+    slot->zused = zbuffSize;
+    ret = zcompress(args->is_zstd, stream, slot->zbuff, &slot->zused, slot->buff, slot->used);
+    *tCompress += wallclock()-t1;
+  }
+  return ret;
+}
+
+// Called by a thread each time round a loop waiting for another thread; *n counts the calls so far in this wait. The
+// first few yield, for the short waits between batches; then it sleeps for 1us doubling to 1ms so that a thread waiting on
+// a slow write, or a writer waiting on slow formatting, does not hold a core that the other threads could be using.
+static void backoff(int *n)
+{
+  int i = (*n)++;
+  if (i<16) {
+#ifdef WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+    return;
+  }
+#ifdef WIN32
+  Sleep(i<26 ? 0 : 1);  // Sleep's granularity is 1ms; Sleep(0) gives up the rest of the time slice
+#else
+  i -= 16;
+  struct timespec ts = {0, 1000L << (i<10 ? i : 10)};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+// write() to f, or append to mem when writing to memory. Returns -1 with errno set on failure, as write() does.
+// Only ever called by one thread at a time: the header before the parallel region and then the writer thread.
+static int sinkWrite(int f, const char *buff, size_t n)
+{
+  if (!mem) return WRITE(f, buff, (int)n);
+  if (mem->len+n > mem->cap) {
+    size_t cap = MAX(2*mem->cap, mem->len+n);  // doubling so that each byte is moved by realloc() at most once on average
+    char *tt = realloc(mem->buff, cap);
+    if (!tt) { errno = ENOMEM; return -1; }      // # nocov
+    mem->buff = tt;
+    mem->cap = cap;
+  }
+  memcpy(mem->buff+mem->len, buff, n);
+  mem->len += n;
+  return (int)n;
+}
+
+static int openFile(const char *filename, bool append)
+{
+#ifdef WIN32
+  return _open(filename, _O_WRONLY | _O_BINARY | _O_CREAT | (append ? _O_APPEND : _O_TRUNC), _S_IWRITE);
+  // O_BINARY rather than O_TEXT for explicit control and speed since it seems that write() has a branch inside it
+  // to convert \n to \r\n on Windows when in text mode not not when in binary mode.
+#else
+  return open(filename, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+  // There is no binary/text mode distinction on Linux and Mac
+#endif
+}
+
+// The buffers of a handle are taken by each call to fwriteMain and given back when it completes. If it fails instead,
+// they are freed as usual and the next call allocates them again.
+static void *takePool(fwriteHandle *h, int k, size_t n)
+{
+  if (!h) return malloc(n);
+  void *p = h->pool[k];
+  h->pool[k] = NULL;
+  if (p && h->poolCap[k]>=n) return p;
+  free(p);
+  h->poolCap[k] = n;
+  return malloc(n);
+}
+
+static void keepPool(fwriteHandle *h, int k, void *p)
+{
+  if (!h) free(p);
+  else if (p) h->pool[k] = p;  // NULL when not used by this call, so the handle's is still there
+}
+
+static void freeStreams(fwriteHandle *h)
+{
+#ifndef NOZLIB
+  for (int i=0; i<h->nstream; i++) deflateEnd((z_stream *)h->streams + i);
+#endif
+  free(h->streams);
+  h->streams = NULL;
+  h->nstream = 0;
+}
+
+fwriteHandle *fwriteOpen(const char *filename, bool append)
+{
+  fwriteHandle *h = calloc(1, sizeof(fwriteHandle));
+  if (!h) return NULL;  // # nocov
+  h->f = openFile(filename, append);
+  if (h->f == -1) {
+    int err = errno;
+    free(h);
+    errno = err;
+    return NULL;
+  }
+  return h;
+}
+
+// Returns 0, or errno from close()
+int fwriteClose(fwriteHandle *h)
+{
+  for (int k=0; k<NPOOL; k++) free(h->pool[k]);
+  freeStreams(h);
+  int ret = CLOSE(h->f) ? errno : 0;
+  free(h);
+  return ret;
+}
+
+// Write partition p to its own file: the header (unless appending to a file that exists already) and then its rows a
+// batch at a time through slot. Returns 0, errno when the file could not be opened, written or closed, or zcompress()'s
+// (negative) error.
+static int writePartition(const fwriteMainArgs *args, int64_t p, int rowsPerBatch, const char *header, size_t headerLen,
+                          RingSlot *slot, size_t zbuffSize, char *myScratch, int *myLen, void *stream,
+                          double *tFormat, double *tCompress, double *tWrite)
+{
+  const char *filename = args->partFiles[p];
+  bool existed = args->append && access(filename, F_OK)!=-1;
+  errno = 0;
+  int f = openFile(filename, args->append);
+  if (f==-1) return errno;
+  int ret = 0;
+  if (headerLen && !existed) {
+    double tw = wallclock();
+    if (compressed) {
+      slot->zused = zbuffSize;
+      ret = zcompress(args->is_zstd, stream, slot->zbuff, &slot->zused, header, headerLen);
+      if (!ret && WRITE(f, slot->zbuff, (int)slot->zused) == -1) ret = errno;
+    } else if (WRITE(f, header, (int)headerLen) == -1) {
+      ret = errno;  // # nocov
+    }
+    *tWrite += wallclock()-tw;
+  }
+  int64_t end = args->partEnd[p];
+  for (int64_t start = p ? args->partEnd[p-1] : 0; start<end && !ret; start+=rowsPerBatch) {
+    ret = formatBatch(args, start, MIN(end, start+rowsPerBatch), slot, zbuffSize, myScratch, myLen, stream, tFormat, tCompress);
+    if (ret) break;
+    double tw = wallclock();
+    if ((compressed ? WRITE(f, slot->zbuff, (int)slot->zused) : WRITE(f, slot->buff, (int)slot->used)) == -1) ret = errno;
+    *tWrite += wallclock()-tw;
+  }
+  if (CLOSE(f) && !ret) ret = errno;  // # nocov
+  return ret;
+}
+
 void fwriteMain(fwriteMainArgs args)
 {
   double startTime = wallclock();
@@ -599,6 +1106,8 @@ void fwriteMain(fwriteMainArgs args)
   scipen = args.scipen;
   doQuote = args.doQuote;
   verbose = args.verbose;
+  mem = args.mem;
+  fwriteHandle *handle = args.handle;
 
   // When NA is a non-empty string, then we must quote all string fields in case they contain the na string
   // na is recommended to be empty, though
@@ -606,8 +1115,21 @@ void fwriteMain(fwriteMainArgs args)
 
   qmethodEscape = args.qmethodEscape;
   squashDateTime = args.squashDateTime;
+  roundtrip = args.roundtrip;
 
   if (args.buffMB<1 || args.buffMB>1024) STOP(_("buffMB=%d outside [1,1024]"), args.buffMB);
+  if (args.is_gzip) {
+    if (args.compressLevel<0 || args.compressLevel>9) STOP(_("compressLevel=%d outside [0,9]"), args.compressLevel);
+    if (args.compressMemLevel<1 || args.compressMemLevel>9) STOP(_("compressMemLevel=%d outside [1,9]"), args.compressMemLevel);
+    compressLevel = args.compressLevel;
+    compressMemLevel = args.compressMemLevel;
+  } else if (args.is_zstd) {
+#ifndef HAVE_ZSTD
+    STOP(_("compress='zstd' needs the zstd library, which this installation of data.table was not compiled with. To enable it, install the zstd development files (e.g. libzstd-dev) and reinstall data.table with PKG_CFLAGS=-DHAVE_ZSTD PKG_LIBS=-lzstd in the environment."));
+#endif
+    if (args.compressLevel<0 || args.compressLevel>22) STOP(_("compressLevel=%d outside [0,22] for zstd"), args.compressLevel);
+    compressLevel = args.compressLevel;  // 0 is zstd's default level, 3
+  }
   size_t buffSize = (size_t)1024*1024*args.buffMB;
 
   int eolLen=strlen(args.eol), naLen=strlen(args.na);
@@ -639,10 +1161,24 @@ void fwriteMain(fwriteMainArgs args)
   // could be console output) and writing column names to it.
 
   double t0 = wallclock();
+  char special[7], *sp=special;  // the characters write_string() looks for
+  if (doQuote==INT8_MIN) {
+    if (sep) *sp++ = sep;
+    if (sep2) *sp++ = sep2;
+    *sp++ = '\n'; *sp++ = '\r'; *sp++ = '"';
+  } else if (doQuote==1) {
+    *sp++ = '"';
+    if (qmethodEscape) *sp++ = '\\';
+  }
+  *sp = '\0';
+  free(plainString);  // in case the previous call stopped with an error before freeing it
+  plainString = calloc(args.ncol, sizeof(bool));
+  if (!plainString) STOP(_("Unable to allocate %d column flags"), args.ncol);  // # nocov
+  int nString=0, nPlain=0;
   size_t maxLineLen = eolLen + args.ncol*(2*(doQuote!=0) + sepLen);
   if (args.doRowNames) {
     maxLineLen += args.rowNames==NULL ? 1+(int)log10(args.nrow)   // the width of the row number
-                  : (args.rowNameFun==WF_String ? getMaxStringLen(args.rowNames, args.nrow)*2  // *2 in case longest row name is all quotes (!) and all get escaped
+                  : (args.rowNameFun==WF_String ? getMaxStringLen(args.rowNames, args.nrow, NULL, args.nth, NULL)*2  // *2 in case longest row name is all quotes (!) and all get escaped
                   : 11); // specific integer names could be MAX_INT 2147483647 (10 chars) even on a 5 row table, and data.frame allows negative integer rownames hence 11 for the sign
     maxLineLen += 2/*possible quotes*/ + sepLen;
   }
@@ -651,10 +1187,12 @@ void fwriteMain(fwriteMainArgs args)
     if (width==0) {
       switch(args.whichFun[j]) {
       case WF_String:
-        width = getMaxStringLen(args.columns[j], args.nrow);
+        width = getMaxStringLen(args.columns[j], args.nrow, special[0] ? special : NULL, args.nth, plainString+j);
+        nString++;
+        nPlain += plainString[j];
         break;
       case WF_CategString:
-        width = getMaxCategLen(args.columns[j]);
+        width = getMaxCategLen(args.columns[j]) + 4;  // +4, doubled below, so that levels can be copied 8 bytes at a time
         break;
       case WF_List:
         width = getMaxListItemLen(args.columns[j], args.nrow);
@@ -667,22 +1205,25 @@ void fwriteMain(fwriteMainArgs args)
     if (width<naLen) width = naLen;
     maxLineLen += width*2;  // *2 in case the longest string is all quotes and they all need to be escaped
   }
-  if (verbose) DTPRINT(_("maxLineLen=%"PRIu64". Found in %.3fs\n"), (uint64_t)maxLineLen, 1.0*(wallclock()-t0));
+  if (verbose) {
+    DTPRINT(_("maxLineLen=%"PRIu64". Found in %.3fs\n"), (uint64_t)maxLineLen, 1.0*(wallclock()-t0));
+    if (nString) DTPRINT(_("%d of %d string columns have no field that needs quoting or escaping\n"), nPlain, nString);
+  }
 
+  const bool partitioned = args.npart>0;
   int f=0;
-  if (*args.filename=='\0') {
+  if (partitioned) {
+    f=-1;  // no single file: each partition's file is opened by the thread that writes it, and nothing goes to the console
+  } else if (mem) {
+    f=-1;  // nor when writing to memory; sinkWrite() appends to mem instead
+  } else if (handle) {
+    f = handle->f;  // opened by fwriteOpen() and closed by fwriteClose(), not here
+  } else if (*args.filename=='\0') {
     f=-1;  // file="" means write to standard output
-    args.is_gzip = false; // gzip is only for file
+    args.is_gzip = args.is_zstd = false; // compression is only for file
     // eol = "\n";  // We'll use DTPRINT which converts \n to \r\n inside it on Windows
   } else {
-#ifdef WIN32
-    f = _open(args.filename, _O_WRONLY | _O_BINARY | _O_CREAT | (args.append ? _O_APPEND : _O_TRUNC), _S_IWRITE);
-    // O_BINARY rather than O_TEXT for explicit control and speed since it seems that write() has a branch inside it
-    // to convert \n to \r\n on Windows when in text mode not not when in binary mode.
-#else
-    f = open(args.filename, O_WRONLY | O_CREAT | (args.append ? O_APPEND : O_TRUNC), 0666);
-    // There is no binary/text mode distinction on Linux and Mac
-#endif
+    f = openFile(args.filename, args.append);
     if (f == -1) {
       // # nocov start
       int erropen = errno;
@@ -697,14 +1238,17 @@ void fwriteMain(fwriteMainArgs args)
   if (args.is_gzip)
     STOP(_("Compression in fwrite uses zlib library. Its header files were not found at the time data.table was compiled. To enable fwrite compression, please reinstall data.table and study the output for further guidance.")); // # nocov
 #endif
+  compressed = args.is_gzip || args.is_zstd;
 
   int yamlLen = strlen(args.yaml);
   if (verbose) {
     DTPRINT(_("Writing bom (%s), yaml (%d characters) and column names (%s) ... "),
             args.bom?"true":"false", yamlLen, args.colNames?"true":"false");
-    if (f==-1) DTPRINT(_("\n"));
+    if (f==-1 && !mem) DTPRINT(_("\n"));
   }
   size_t headerLen = 0;
+  char *partHeader = NULL;  // when partitioned, the header is kept to be written at the top of each partition's file
+  size_t partHeaderLen = 0;
   if (args.bom) headerLen += 3;
   headerLen += yamlLen;
   if (args.colNames) {
@@ -733,7 +1277,10 @@ void fwriteMain(fwriteMainArgs args)
       ch -= sepLen; // backup over the last sep
       write_chars(args.eol, &ch);
     }
-    if (f==-1) {
+    if (partitioned) {
+      partHeader = buff;
+      partHeaderLen = ch-buff;
+    } else if (f==-1 && !mem) {
       *ch = '\0';
       DTPRINT(buff);
       free(buff);
@@ -756,19 +1303,36 @@ void fwriteMain(fwriteMainArgs args)
         }
         size_t zbuffUsed = zbuffSize;
         ret1 = compressbuff(&stream, zbuff, &zbuffUsed, buff, (size_t)(ch-buff));
-        if (ret1==Z_OK) ret2 = WRITE(f, zbuff, (int)zbuffUsed);
+        if (ret1==Z_OK) ret2 = sinkWrite(f, zbuff, zbuffUsed);
         deflateEnd(&stream);
         free(zbuff);
+#endif
+      } else if (args.is_zstd) {
+#ifdef HAVE_ZSTD
+        ZSTD_CCtx *cctx = ZSTD_createCCtx();
+        size_t zbuffSize = ZSTD_compressBound(ch-buff);
+        char *zbuff = malloc(zbuffSize);
+        if (!cctx || !zbuff) {
+          // # nocov start
+          ZSTD_freeCCtx(cctx); free(zbuff); free(buff);
+          STOP(_("Unable to allocate %d MiB for zbuffer: %s"), zbuffSize / 1024 / 1024, strerror(errno));
+          // # nocov end
+        }
+        size_t zbuffUsed = zbuffSize;
+        ret1 = zcompress(true, cctx, zbuff, &zbuffUsed, buff, (size_t)(ch-buff));
+        if (!ret1) ret2 = sinkWrite(f, zbuff, zbuffUsed);
+        ZSTD_freeCCtx(cctx);
+        free(zbuff);
 #endif
       } else {
-        ret2 = WRITE(f,  buff, (int)(ch-buff));
+        ret2 = sinkWrite(f, buff, ch-buff);
       }
       free(buff);
       if (ret1 || ret2==-1) {
         // # nocov start
         int errwrite = errno; // capture write errno now incase close fails with a different errno
-        CLOSE(f);
-        if (ret1) STOP(_("Compress gzip error: %d"), ret1);
+        if (f!=-1 && !handle) CLOSE(f);
+        if (ret1) STOP(_("Compress %s error: %d"), args.is_zstd ? "zstd" : "gzip", ret1);
         else      STOP(_("%s: '%s'"), strerror(errwrite), args.filename);
         // # nocov end
       }
@@ -777,7 +1341,9 @@ void fwriteMain(fwriteMainArgs args)
   if (verbose) DTPRINT(_("done in %.3fs\n"), 1.0*(wallclock()-t0));
   if (args.nrow == 0) {
     if (verbose) DTPRINT(_("No data rows present (nrow==0)\n"));
-    if (f!=-1 && CLOSE(f)) STOP(_("%s: '%s'"), strerror(errno), args.filename);
+    free(partHeader);
+    free(plainString); plainString = NULL;
+    if (f!=-1 && !handle && CLOSE(f)) STOP(_("%s: '%s'"), strerror(errno), args.filename);
     return;
   }
 
@@ -793,195 +1359,404 @@ void fwriteMain(fwriteMainArgs args)
   int numBatches = (args.nrow-1)/rowsPerBatch + 1;
   int nth = args.nth;
   if (numBatches < nth) nth = numBatches;
+  if (partitioned) nth = MIN(args.nth, args.npart);
+  // nth-1 threads format batches of rows into a ring of buffers, two per formatting thread, and thread 0 writes the
+  // completed buffers to the file in batch order. A formatting thread only waits for the writer when the ring is full,
+  // rather than every batch waiting its turn in an ordered section to call write() itself; e.g. on slow network drives.
+  // The writer is thread 0 because it calls DTPRINT when writing to the console and for the progress meter, and it is
+  // one of the nth threads so that nThread is not exceeded.
+  // With nth==1, or when OpenMP provides one thread, thread 0 formats and writes each batch in turn.
+  // When partitioned, each of nth threads takes the next partition and formats and writes all of it to its own file
+  // through its own buffer, so there is no order to keep between threads.
+  int nteam = nth;
+  int nslot = partitioned ? nth : (nth>1 ? 2*(nth-1) : 1);
   if (verbose) {
-    DTPRINT(_("Writing %"PRId64" rows in %d batches of %d rows (each buffer size %dMB, showProgress=%d, nth=%d)\n"),
-            args.nrow, numBatches, rowsPerBatch, args.buffMB, args.showProgress, nth);
+    if (partitioned) {
+      DTPRINT(_("Writing %"PRId64" rows to %"PRId64" files using %d threads, in batches of up to %d rows (each buffer size %dMB)\n"),
+              args.nrow, args.npart, nth, rowsPerBatch, args.buffMB);
+    } else {
+      DTPRINT(_("Writing %"PRId64" rows in %d batches of %d rows (each buffer size %dMB, showProgress=%d, nth=%d)\n"),
+              args.nrow, numBatches, rowsPerBatch, args.buffMB, args.showProgress, nth);
+      if (nteam>1) DTPRINT(_("%d formatting threads fill a ring of %d buffers which thread 0 writes\n"), nth-1, nslot);
+    }
   }
   t0 = wallclock();
 
   bool hasPrinted = false;
   int maxBuffUsedPC = 0;
 
-  // compute zbuffSize which is the same for each thread
+  // A handle keeps a gzip stream for each thread initialized between calls, reset ready for the next call's batches
+  void *keptStreams = NULL;
+#ifndef NOZLIB
+  if (handle && args.is_gzip) {
+    if (handle->nstream < nteam) {
+      freeStreams(handle);
+      handle->streams = malloc(nteam*sizeof(z_stream));
+      if (!handle->streams) STOP(_("Can't allocate gzip stream structure"));  // # nocov
+      for (; handle->nstream<nteam; handle->nstream++) {
+        if (init_stream((z_stream *)handle->streams + handle->nstream)) STOP(_("Can't allocate gzip stream structure"));  // # nocov
+      }
+    } else {
+      for (int i=0; i<nteam; i++) deflateReset((z_stream *)handle->streams + i);  // in case the previous call failed part way
+    }
+    keptStreams = handle->streams;
+  }
+#endif
+
+  // compute zbuffSize which is the same for each buffer
   size_t zbuffSize = 0;
   if(args.is_gzip){
 #ifndef NOZLIB
     z_stream stream = {0};
-    if(init_stream(&stream))
-      STOP(_("Can't allocate gzip stream structure")); // # nocov
-    zbuffSize = deflateBound(&stream, buffSize);
-    if (verbose) DTPRINT(_("zbuffSize=%d returned from deflateBound\n"), (int)zbuffSize);
-    deflateEnd(&stream);
+    if (keptStreams) {
+      zbuffSize = deflateBound(keptStreams, MAX(buffSize, partHeaderLen));
+    } else {
+      if(init_stream(&stream))
+        STOP(_("Can't allocate gzip stream structure")); // # nocov
+      zbuffSize = deflateBound(&stream, MAX(buffSize, partHeaderLen));  // each partition's header is compressed through the same buffers
+      deflateEnd(&stream);
+    }
+    if (verbose) DTPRINT(_("zbuffSize=%d returned from deflateBound with compressLevel=%d and compressMemLevel=%d\n"), (int)zbuffSize, compressLevel, compressMemLevel);
+#endif
+  } else if (args.is_zstd) {
+#ifdef HAVE_ZSTD
+    zbuffSize = ZSTD_compressBound(MAX(buffSize, partHeaderLen));
+    if (verbose) DTPRINT(_("zbuffSize=%d returned from ZSTD_compressBound with compressLevel=%d\n"), (int)zbuffSize, compressLevel);
 #endif
   }
 
   errno=0;
-  char *buffPool = malloc(nth*(size_t)buffSize);
+  char *buffPool = takePool(handle, POOL_BUFF, nslot*(size_t)buffSize);
   if (!buffPool) {
     // # nocov start
+    free(partHeader);
     STOP(_("Unable to allocate %d MB * %d thread buffers; '%d: %s'. Please read ?fwrite for nThread, buffMB and verbose options."),
-         (size_t)buffSize/(1024^2), nth, errno, strerror(errno));
+         (size_t)buffSize/(1024^2), nslot, errno, strerror(errno));
     // # nocov end
   }
   char *zbuffPool = NULL;
-  if (args.is_gzip) {
-    zbuffPool = malloc(nth*(size_t)zbuffSize);
-#ifndef NOZLIB
+  if (compressed) {
+    zbuffPool = takePool(handle, POOL_ZBUFF, nslot*(size_t)zbuffSize);
     if (!zbuffPool) {
       // # nocov start
-      free(buffPool);
+      free(buffPool); free(partHeader);
       STOP(_("Unable to allocate %d MB * %d thread compressed buffers; '%d: %s'. Please read ?fwrite for nThread, buffMB and verbose options."),
-         (size_t)zbuffSize/(1024^2), nth, errno, strerror(errno));
+         (size_t)zbuffSize/(1024^2), nslot, errno, strerror(errno));
       // # nocov end
     }
-#endif
+  }
+  RingSlot *ring = malloc(nslot*sizeof(RingSlot));
+  if (!ring) {
+    // # nocov start
+    free(buffPool); free(zbuffPool); free(partHeader);
+    STOP(_("Unable to allocate %d buffer descriptors"), nslot);
+    // # nocov end
+  }
+  for (int s=0; s<nslot; s++) {
+    ring[s].buff = buffPool + s*buffSize;
+    ring[s].zbuff = compressed ? zbuffPool + s*zbuffSize : NULL;
+    ring[s].used = ring[s].zused = 0;
+    ring[s].batch = -1;
   }
 
+  // Fixed-width columns are formatted a run of rows at a time into each thread's scratch area (see batchFuns above) and
+  // the fields are then copied into the line. Each batched column j has a slot of batchWidth[j] bytes per row, the
+  // width its writer can write at most rounded up to a multiple of 8 so that fields can be copied 8 bytes at a time;
+  // batchWidth[j]==0 means column j is written cell by cell. The scratch is laid out column by column (runRows slots
+  // for column 0, then column 1, ...) so that each batch writer writes contiguously.
+  batchWidth = malloc(args.ncol*sizeof(int));
+  batchOff = malloc(args.ncol*sizeof(size_t));
+  if (!batchWidth || !batchOff) {
+    // # nocov start
+    free(batchWidth); free(batchOff); batchWidth=NULL; batchOff=NULL; free(ring); free(buffPool); free(zbuffPool); free(partHeader);
+    STOP(_("Unable to allocate %d column widths for batch writers"), args.ncol);
+    // # nocov end
+  }
+  int nBatchCols=0;
+  size_t rowWidth=0;
+  for (int j=0; j<args.ncol; j++) {
+    int wf = args.whichFun[j], width = 0;
+    if (batchFuns[wf] && args.funs[wf]==cellFuns[wf]) {
+      width = writerMaxLen[wf];
+      if (wf==WF_Float64 && args.scipen>0) width+=MIN(args.scipen,350);  // as in maxLineLen above
+      if (width<naLen) width = naLen;
+      width = (width+7) & ~7;
+      nBatchCols++;
+    }
+    batchWidth[j] = width;
+    rowWidth += width;
+  }
+  // a run of up to 256 rows, limited so the scratch stays within about 1MB per thread for very wide tables
+  runRows = rowWidth==0 ? 1 : (int)MAX(1, MIN(256, 1024*1024/rowWidth));
+  if (runRows > rowsPerBatch) runRows = rowsPerBatch;
+  size_t off=0;
+  for (int j=0; j<args.ncol; j++) { batchOff[j] = off*runRows; off+=batchWidth[j]; }
+  size_t scratchSize = rowWidth*runRows;
+  char *scratchPool = nBatchCols ? takePool(handle, POOL_SCRATCH, nteam*scratchSize) : NULL;
+  int *lenPool = nBatchCols ? takePool(handle, POOL_LEN, nteam*(size_t)args.ncol*runRows*sizeof(int)) : NULL;
+  if (nBatchCols && (!scratchPool || !lenPool)) {
+    // # nocov start
+    free(scratchPool); free(lenPool); free(batchWidth); free(batchOff); batchWidth=NULL; batchOff=NULL;
+    free(ring); free(buffPool); free(zbuffPool); free(partHeader);
+    STOP(_("Unable to allocate %d MB * %d thread scratch areas for batch writers; '%d: %s'. Please read ?fwrite for nThread, buffMB and verbose options."),
+         (int)(scratchSize/(1024*1024)), nteam, errno, strerror(errno));
+    // # nocov end
+  }
+  if (verbose) DTPRINT(_("%d of %d columns are formatted %d rows at a time (scratch %dKB per thread)\n"),
+                       nBatchCols, args.ncol, runRows, (int)(scratchSize/1024));
+
+  // A factor with no more levels than rows is written from its levels prepared here; otherwise (e.g. a few rows of a
+  // factor with many unused levels) preparing them all would take longer than writing the rows cell by cell.
+  categ = calloc(args.ncol, sizeof(CategLevels));
+  int nCategCols=0;
+  bool categOk = categ!=NULL;
+  for (int j=0; j<args.ncol && categOk; j++) {
+    if (args.whichFun[j]!=WF_CategString || args.funs[WF_CategString]!=(writer_fun_t)writeCategString) continue;
+    if (getCategNLevels(args.columns[j]) > args.nrow) continue;
+    categOk = initCategLevels(args.columns[j], categ+j);
+    nCategCols++;
+  }
+  if (!categOk) {
+    // # nocov start
+    freeCategLevels(args.ncol);
+    free(scratchPool); free(lenPool); free(batchWidth); free(batchOff); batchWidth=NULL; batchOff=NULL;
+    free(ring); free(buffPool); free(zbuffPool); free(partHeader);
+    STOP(_("Unable to allocate the levels of factor columns"));
+    // # nocov end
+  }
+  if (verbose && nCategCols) DTPRINT(_("%d factor columns are written from their levels quoted and escaped up front\n"), nCategCols);
+
   bool failed = false;   // naked (unprotected by atomic) write to bool ok because only ever write true in this special paradigm
-  int failed_compress = 0; // the first thread to fail writes their reason here when they first get to ordered section
+  int failed_compress = 0; // the first thread to fail writes their reason here
   int failed_write = 0;    // same. could use +ve and -ve in the same code but separate it out to trace Solaris problem, #3931
+  int64_t nextBatch = 0;   // the next batch for a formatting thread to take, or the next partition when partitioned
+  int64_t failed_part = -1; // when partitioned, the partition whose file failed to be written
+  int64_t nWritten = 0;    // batches written so far; batch b may use ring[b%nslot] once batch b-nslot has been written
+  int team = 1;            // the number of threads OpenMP actually provided
+  double tFormat[nteam], tCompress[nteam], tWait[nteam], tWrite=0;  // per thread; tWait is for a free buffer or, for the writer, the next batch
+                                                                     // and, when partitioned, the time spent writing instead
 
 #ifndef NOZLIB
-  z_stream thread_streams[nth];
+  z_stream thread_streams[nteam];
   // VLA on stack should be fine for nth structs; in zlib v1.2.11 sizeof(struct)==112 on 64bit
   // not declared inside the parallel region because solaris appears to move the struct in
-  // memory when the #pragma omp for is entered, which causes zlib's internal self reference
+  // memory when the parallel region is entered, which causes zlib's internal self reference
   // pointer to mismatch, #4099
-  char failed_msg[1001] = "";  // to hold zlib's msg; copied out of zlib in ordered section just in case the msg is allocated within zlib
+  char failed_msg[1001] = "";  // to hold zlib's msg; copied out of zlib when the error happens just in case the msg is allocated within zlib
 #endif
 
-  #pragma omp parallel num_threads(nth)
+  #pragma omp parallel num_threads(nteam)
   {
     int me = omp_get_thread_num();
-    int my_failed_compress = 0;
-    char *ch, *myBuff;
-    ch = myBuff = buffPool + me*buffSize;
-
-    void *myzBuff = NULL;
-    size_t myzbuffUsed = 0;
+    if (me==0) team = omp_get_num_threads();
+    bool formatter = partitioned || me>0 || omp_get_num_threads()==1;
+    tFormat[me] = tCompress[me] = tWait[me] = 0.0;
+    char *myScratch = scratchPool + me*scratchSize;  // scratchPool is NULL when there are no batched columns; then unused
+    int *myLen = lenPool + me*(size_t)args.ncol*runRows;
+    void *mystream = NULL;
 #ifndef NOZLIB
-    z_stream *mystream = &thread_streams[me];
-    if (args.is_gzip) {
-      myzBuff = zbuffPool + me*zbuffSize;
+    if (args.is_gzip && formatter && keptStreams) {
+      mystream = (z_stream *)keptStreams + me;
+    } else if (args.is_gzip && formatter) {
+      mystream = &thread_streams[me];
       if (init_stream(mystream)) { // this should be thread safe according to zlib documentation
-        failed = true;              // # nocov
-        my_failed_compress = -998;  // # nocov
+        // # nocov start
+        failed = true;
+        #pragma omp critical(fwriteFailed)
+        if (failed_compress==0) failed_compress = -998;
+        mystream = NULL;
+        // # nocov end
+      }
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (args.is_zstd && formatter) {
+      mystream = ZSTD_createCCtx();  // each thread's own, as a z_stream is
+      if (!mystream) {
+        // # nocov start
+        failed = true;
+        #pragma omp critical(fwriteFailed)
+        if (failed_compress==0) failed_compress = -998;
+        // # nocov end
       }
     }
 #endif
 
-    #pragma omp for ordered schedule(dynamic)
-    for(int64_t start=0; start<args.nrow; start+=rowsPerBatch) {
-      if (failed) continue;  // Not break. Because we don't use #omp cancel yet.
-      int64_t end = ((args.nrow - start)<rowsPerBatch) ? args.nrow : start + rowsPerBatch;
-      for (int64_t i=start; i<end; i++) {
-        // Tepid starts here (once at beginning of each line)
-        if (args.doRowNames) {
-          if (args.rowNames==NULL) {
-            if (doQuote==1) *ch++='"';
-            int64_t rn = i+1;
-            writeInt64(&rn, 0, &ch);
-            if (doQuote==1) *ch++='"';
-          } else {
-            if (args.rowNameFun != WF_String && doQuote==1) *ch++='"';
-            (args.funs[args.rowNameFun])(args.rowNames, i, &ch);  // #5098
-            if (args.rowNameFun != WF_String && doQuote==1) *ch++='"';
+    if (partitioned) {
+      // Each thread takes the next partition and writes all of it to its own file through its own buffer
+      for (;;) {
+        int64_t p;
+        #pragma omp atomic capture
+        p = nextBatch++;
+        if (p>=args.npart || failed) break;
+        int ret = writePartition(&args, p, rowsPerBatch, partHeader, partHeaderLen, &ring[me], zbuffSize, myScratch, myLen,
+                                 mystream, &tFormat[me], &tCompress[me], &tWait[me]);
+        if (ret) {
+          failed = true;
+          #pragma omp critical(fwriteFailed)
+          if (failed_part==-1) {
+            failed_part = p;
+            if (ret>0) failed_write = ret;
+            else {
+              // # nocov start
+              failed_compress = ret;
+#ifndef NOZLIB
+              z_stream *zs = mystream;
+              if (args.is_gzip && zs->msg!=NULL) strncpy(failed_msg, zs->msg, 1000);
+#endif
+              // # nocov end
+            }
           }
-          *ch = sep;
-          ch += sepLen;
-        }
-        // Hot loop
-        for (int j=0; j<args.ncol; j++) {
-          (args.funs[args.whichFun[j]])(args.columns[j], i, &ch);
-          *ch = sep;
-          ch += sepLen;
+          break;
         }
-        // Tepid again (once at the end of each line)
-        ch -= sepLen;  // backup onto the last sep after the last column. ncol>=1 because 0-columns was caught earlier.
-        write_chars(args.eol, &ch);  // overwrite last sep with eol instead
       }
-      // compress buffer if gzip
-#ifndef NOZLIB
-      if (args.is_gzip && !failed) {
-        myzbuffUsed = zbuffSize;
-        int ret = compressbuff(mystream, myzBuff, &myzbuffUsed, myBuff, (size_t)(ch-myBuff));
-        if (ret) { failed=true; my_failed_compress=ret; }
-        else deflateReset(mystream);
-      }
-#endif
-      #pragma omp ordered
-      {
-        if (failed) {
+    } else if (me>0) {
+      // Formatting thread: take the next batch, wait for its buffer to be free, fill it and mark it ready for the writer
+      for (;;) {
+        int64_t b;
+        #pragma omp atomic capture
+        b = nextBatch++;
+        if (b>=numBatches || failed) break;
+        RingSlot *slot = &ring[b%nslot];
+        double tw = wallclock();
+        int nwait = 0;
+        for (;;) {
+          int64_t nw;
+          #pragma omp atomic read
+          nw = nWritten;
+          if (b-nw<nslot || failed) break;
+          backoff(&nwait);
+        }
+        tWait[me] += wallclock()-tw;
+        if (failed) break;
+        #pragma omp flush
+        int64_t start = b*rowsPerBatch, end = MIN(args.nrow, start+rowsPerBatch);
+        int ret = formatBatch(&args, start, end, slot, zbuffSize, myScratch, myLen, mystream, &tFormat[me], &tCompress[me]);
+        if (ret) {
           // # nocov start
-          if (failed_compress==0 && my_failed_compress!=0) {
-            failed_compress = my_failed_compress;
+          failed = true;
+          #pragma omp critical(fwriteFailed)
+          if (failed_compress==0) {
+            failed_compress = ret;
 #ifndef NOZLIB
-            if (mystream->msg!=NULL) strncpy(failed_msg, mystream->msg, 1000); // copy zlib's msg for safe use after deflateEnd just in case zlib allocated the message
+            z_stream *zs = mystream;
+            if (args.is_gzip && zs->msg!=NULL) strncpy(failed_msg, zs->msg, 1000); // copy zlib's msg for safe use after deflateEnd just in case zlib allocated the message
 #endif
           }
-          // else another thread could have failed below while I was working or waiting above; their reason got here first
+          break;
           // # nocov end
-        } else {
-          errno=0;
-          if (f==-1) {
-            *ch='\0';  // standard C string end marker so DTPRINT knows where to stop
-            DTPRINT(myBuff);
-          } else if ((args.is_gzip ? WRITE(f, myzBuff, (int)myzbuffUsed)
-                                   : WRITE(f, myBuff,  (int)(ch-myBuff))) == -1) {
-            failed=true;         // # nocov
-            failed_write=errno;  // # nocov
-          }
-
-          int used = 100*((double)(ch-myBuff))/buffSize;  // percentage of original buffMB
-          if (used > maxBuffUsedPC) maxBuffUsedPC = used;
-          double now;
-          if (me==0 && args.showProgress && (now=wallclock())>=nextTime && !failed) {
-            // See comments above inside the f==-1 clause.
-            // Not only is this ordered section one-at-a-time but we'll also Rprintf() here only from the
-            // master thread (me==0) and hopefully this will work on Windows. If not, user should set
-            // showProgress=FALSE until this can be fixed or removed.
+        }
+        #pragma omp flush
+        #pragma omp atomic write
+        slot->batch = b;
+      }
+    } else {
+      // Writer (thread 0): write the batches in order as they become ready, or format each itself first when alone
+      for (int64_t b=0; b<numBatches && !failed; b++) {
+        RingSlot *slot = &ring[b%nslot];
+        int64_t start = b*rowsPerBatch, end = MIN(args.nrow, start+rowsPerBatch);
+        if (formatter) {
+          int ret = formatBatch(&args, start, end, slot, zbuffSize, myScratch, myLen, mystream, &tFormat[me], &tCompress[me]);
+          if (ret) {
             // # nocov start
-            int ETA = (int)((args.nrow-end)*((now-startTime)/end));
-            if (hasPrinted || ETA >= 2) {
-              if (verbose && !hasPrinted) DTPRINT("\n");
-              DTPRINT("\rWritten %.1f%% of %"PRId64" rows in %d secs using %d thread%s. "
-                      "maxBuffUsed=%d%%. ETA %d secs.      ",
-                       (100.0*end)/args.nrow, args.nrow, (int)(now-startTime), nth, nth==1?"":"s",
-                       maxBuffUsedPC, ETA);
-              // TODO: use progress() as in fread
-              nextTime = now+1;
-              hasPrinted = true;
-            }
+            failed = true;
+            failed_compress = ret;
+#ifndef NOZLIB
+            z_stream *zs = mystream;
+            if (args.is_gzip && zs->msg!=NULL) strncpy(failed_msg, zs->msg, 1000);
+#endif
+            break;
             // # nocov end
           }
-          // May be possible for master thread (me==0) to call R_CheckUserInterrupt() here.
-          // Something like:
-          // if (me==0) {
-          //   failed = TRUE;  // inside ordered here; the slaves are before ordered and not looking at 'failed'
-          //   R_CheckUserInterrupt();
-          //   failed = FALSE; // no user interrupt so return state
-          // }
-          // But I fear the slaves will hang waiting for the master (me==0) to complete the ordered
-          // section which may not happen if the master thread has been interrupted. Rather than
-          // seeing failed=TRUE and falling through to free() and close() as intended.
-          // Could register a finalizer to free() and close() perhaps :
-          // [r-devel] http://r.789695.n4.nabble.com/checking-user-interrupts-in-C-code-tp2717528p2717722.html
-          // Conclusion for now: do not provide ability to interrupt.
-          // write() errors and malloc() fails will be caught and cleaned up properly, however.
-          ch = myBuff;  // back to the start of my buffer ready to fill it up again
+        } else {
+          double tw = wallclock();
+          int nwait = 0;
+          for (;;) {
+            int64_t ready;
+            #pragma omp atomic read
+            ready = slot->batch;
+            if (ready==b || failed) break;
+            backoff(&nwait);
+          }
+          tWait[me] += wallclock()-tw;
+          if (failed) break;
+          #pragma omp flush
+        }
+        double tw = wallclock();
+        errno=0;
+        if (f==-1 && !mem) {
+          slot->buff[slot->used]='\0';  // standard C string end marker so DTPRINT knows where to stop
+          DTPRINT(slot->buff);
+        } else if ((compressed ? sinkWrite(f, slot->zbuff, slot->zused)
+                                 : sinkWrite(f, slot->buff,  slot->used)) == -1) {
+          failed=true;         // # nocov
+          failed_write=errno;  // # nocov
+        }
+        tWrite += wallclock()-tw;
+
+        int used = 100*((double)slot->used)/buffSize;  // percentage of original buffMB
+        if (used > maxBuffUsedPC) maxBuffUsedPC = used;
+        double now;
+        if (args.showProgress && (now=wallclock())>=nextTime && !failed) {
+          // The writer is the master thread (me==0) so it is ok to call DTPRINT (Rprintf) here, as it is for f==-1
+          // above. If this does not work on Windows, the user should set showProgress=FALSE until it can be fixed.
+          // # nocov start
+          int ETA = (int)((args.nrow-end)*((now-startTime)/end));
+          if (hasPrinted || ETA >= 2) {
+            if (verbose && !hasPrinted) DTPRINT("\n");
+            DTPRINT("\rWritten %.1f%% of %"PRId64" rows in %d secs using %d thread%s. "
+                    "maxBuffUsed=%d%%. ETA %d secs.      ",
+                     (100.0*end)/args.nrow, args.nrow, (int)(now-startTime), nth, nth==1?"":"s",
+                     maxBuffUsedPC, ETA);
+            // TODO: use progress() as in fread
+            nextTime = now+1;
+            hasPrinted = true;
+          }
+          // # nocov end
         }
+        // May be possible for master thread (me==0) to call R_CheckUserInterrupt() here. But the formatting
+        // threads would then need to see failed=true and leave their loops before the master thread could longjmp
+        // out of the parallel region, and the buffers would need a finalizer to be free()-ed and the file close()-d.
+        // [r-devel] http://r.789695.n4.nabble.com/checking-user-interrupts-in-C-code-tp2717528p2717722.html
+        // Conclusion for now: do not provide ability to interrupt.
+        // write() errors and malloc() fails will be caught and cleaned up properly, however.
+        #pragma omp flush
+        #pragma omp atomic write
+        nWritten = b+1;  // this buffer may now be reused
       }
     }
-    // all threads will call this free on their buffer, even if one or more threads had malloc
-    // or realloc fail. If the initial malloc failed, free(NULL) is ok and does nothing.
-    if (args.is_gzip) {
+#ifdef HAVE_ZSTD
+    if (args.is_zstd) { ZSTD_freeCCtx(mystream); mystream = NULL; }
+#endif
 #ifndef NOZLIB
-      deflateEnd(mystream);
+    if (mystream && !keptStreams) deflateEnd(mystream);
 #endif
+  }
+  free(ring);
+  keepPool(handle, POOL_BUFF, buffPool);
+  keepPool(handle, POOL_ZBUFF, zbuffPool);
+  keepPool(handle, POOL_SCRATCH, scratchPool);
+  keepPool(handle, POOL_LEN, lenPool);
+  free(batchWidth); batchWidth = NULL;
+  free(batchOff); batchOff = NULL;
+  freeCategLevels(args.ncol);
+  free(plainString); plainString = NULL;
+
+  free(partHeader);
+
+  if (verbose) {
+    if (partitioned) {
+      for (int i=0; i<team; i++)
+        DTPRINT(_("Thread %d formatted for %.3fs, compressed for %.3fs and wrote for %.3fs\n"), i, tFormat[i], tCompress[i], tWait[i]);
+    } else if (team==1) {
+      DTPRINT(_("Formatted in %.3fs, compressed in %.3fs and written in %.3fs\n"), tFormat[0], tCompress[0], tWrite);
+    } else {
+      for (int i=1; i<team; i++)
+        DTPRINT(_("Thread %d formatted for %.3fs, compressed for %.3fs and waited %.3fs for a free buffer\n"), i, tFormat[i], tCompress[i], tWait[i]);
+      DTPRINT(_("Thread 0 wrote for %.3fs and waited %.3fs for the next batch\n"), tWrite, tWait[0]);
     }
+    if (mem) DTPRINT(_("%"PRIu64" bytes written to memory\n"), (uint64_t)mem->len);
   }
-  free(buffPool);
-  free(zbuffPool);
 
   // Finished parallel region and can call R API safely now.
   if (hasPrinted) {
@@ -995,7 +1770,7 @@ void fwriteMain(fwriteMainArgs args)
     // # nocov end
   }
 
-  if (f!=-1 && CLOSE(f) && !failed)
+  if (f!=-1 && !handle && CLOSE(f) && !failed)
     STOP("%s: '%s'", strerror(errno), args.filename);  // # nocov
   // quoted '%s' in case of trailing spaces in the filename
   // If a write failed, the line above tries close() to clean up, but that might fail as well. So the
@@ -1003,6 +1778,12 @@ void fwriteMain(fwriteMainArgs args)
   // from the original error.
   if (failed) {
     // # nocov start
+    if (mem) { free(mem->buff); mem->buff=NULL; mem->len=mem->cap=0; }
+#ifdef HAVE_ZSTD
+    if (failed_compress && args.is_zstd)
+      STOP(_("zstd %s ZSTD_compressCCtx() failed: %s"), ZSTD_versionString(),
+           failed_compress==-998 ? _("could not allocate a compression context") : ZSTD_getErrorString((ZSTD_ErrorCode)-failed_compress));
+#endif
 #ifndef NOZLIB
     if (failed_compress)
       STOP(_("zlib %s (zlib.h %s) deflate() returned error %d with z_stream->msg==\"%s\" Z_FINISH=%d Z_BLOCK=%d. %s"),
@@ -1011,7 +1792,7 @@ void fwriteMain(fwriteMainArgs args)
                    : _("Please retry fwrite() with verbose=TRUE and include the full output with your data.table bug report."));
 #endif
     if (failed_write)
-      STOP("%s: '%s'", strerror(failed_write), args.filename);
+      STOP("%s: '%s'", strerror(failed_write), partitioned ? args.partFiles[failed_part] : (mem ? "<memory>" : args.filename));
     // # nocov end
   }
 }
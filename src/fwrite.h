@@ -65,6 +65,24 @@ static const int writerMaxLen[] = {  // same order as fun[] and WFs above; max f
   0,  //&writeList
 };
 
+// When fwriteMainArgs.mem is not NULL the output (compressed when is_gzip or is_zstd) is appended here rather than written to a file
+typedef struct MemSink {
+  char *buff;   // malloc()-ed and grown as needed; the caller takes it (and frees it) afterwards
+  size_t len;
+  size_t cap;
+} MemSink;
+
+// A file kept open by fwriteOpen() so that many tables can be appended to it, each by a call to fwriteMain, without
+// opening the file, allocating the buffers or initializing the gzip streams again for each one
+enum { POOL_BUFF, POOL_ZBUFF, POOL_SCRATCH, POOL_LEN, NPOOL };
+typedef struct fwriteHandle {
+  int f;                 // the open file
+  void *pool[NPOOL];     // the buffers of the last call, kept for the next; NULL while in use or before first use
+  size_t poolCap[NPOOL]; // the size of each
+  void *streams;         // nstream z_streams initialized for the gzip stream of each thread, or NULL
+  int nstream;
+} fwriteHandle;
+
 typedef struct fwriteMainArgs
 {
   // Name of the file to open (a \0-terminated C string). If the file name
@@ -102,16 +120,32 @@ typedef struct fwriteMainArgs
                           //   deciding to write scientific or full decimal format (e.g. in comparing
                           //   10000000 to 1e+07, first has width 8, second has width 5; prefer the former
                           //   iff scipen >= 3=8-5
+  bool roundtrip;         // write doubles with the fewest significant digits (up to 17) that read back exactly, rather than 15
   bool squashDateTime;
   bool append;
   int buffMB;             // [1-1024] default 8MB
   int nth;
   bool showProgress;
   bool is_gzip;
+  bool is_zstd;           // each batch compressed as a zstd frame; needs data.table compiled with HAVE_ZSTD
+  int compressLevel;      // [0-9] passed to zlib; 1 is fastest, 9 compresses most, 0 stores uncompressed. zlib's default is 6
+                          // [0-22] passed to zstd when is_zstd, where 0 means zstd's default of 3
+  int compressMemLevel;   // [1-9] zlib's memLevel; more memory is faster and compresses slightly better. zlib's default is 8
   bool bom;
   const char *yaml;
   bool verbose;
+
+  // When npart>0 the rows are written partition by partition, each to its own file, rather than to filename
+  int64_t npart;
+  const char **partFiles;   // npart file names
+  const int32_t *partRows;  // nrow row numbers (1-based), grouped by partition; e.g. the order from forder()
+  const int64_t *partEnd;   // npart; partition p is partRows[partEnd[p-1]] up to (excluding) partRows[partEnd[p]]
+
+  MemSink *mem;             // NULL, or write to memory instead of filename
+  fwriteHandle *handle;     // NULL, or append to this file already open instead of filename
 } fwriteMainArgs;
 
 void fwriteMain(fwriteMainArgs args);
+fwriteHandle *fwriteOpen(const char *filename, bool append);
+int fwriteClose(fwriteHandle *h);
 
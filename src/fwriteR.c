@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <errno.h>
 #include "data.table.h"
 #include "fwrite.h"
 
@@ -28,23 +29,46 @@ int getStringLen(SEXP *col, int64_t row) {
   return LENGTH(col[row]);  // LENGTH of CHARSXP is nchar
 }
 
-int getMaxStringLen(const SEXP *col, const int64_t n) {
+int getMaxStringLen(const SEXP *col, const int64_t n, const char *special, int nth, bool *plain) {
+  // Scanned in parallel in chunks of rows. When special!=NULL, *plain is also set to whether none of the strings contain
+  // any of those characters, so that the column can be written without looking for them again in every field. Only the
+  // bytes of the CHARSXP are read (nothing is translated or allocated here) so a string that would be translated when
+  // written is taken as not plain.
+  const int64_t chunk = 65536, nchunk = (n+chunk-1)/chunk;
   int max=0;
-  SEXP last=NULL;
-  for (int64_t i=0; i<n; ++i) {
-    SEXP this = *col++;
-    if (this==last) continue; // no point calling LENGTH() again on the same string; LENGTH is unlikely as fast as single pointer compare
-    int thisnchar = LENGTH(this);
-    if (thisnchar>max) max=thisnchar;
-    last = this;
+  bool anySpecial=false;
+  #pragma omp parallel num_threads(nchunk>1 ? nth : 1)
+  {
+    int mymax=0;
+    bool mySpecial=false;
+    #pragma omp for schedule(static)
+    for (int64_t c=0; c<nchunk; ++c) {
+      const int64_t to = MIN(n, (c+1)*chunk);
+      SEXP last=NULL;
+      for (int64_t i=c*chunk; i<to; ++i) {
+        SEXP this = col[i];
+        if (this==last) continue; // no point calling LENGTH() again on the same string; LENGTH is unlikely as fast as single pointer compare
+        int thisnchar = LENGTH(this);
+        if (thisnchar>mymax) mymax=thisnchar;
+        if (special && !mySpecial && this!=NA_STRING)
+          mySpecial = TO_UTF8(this) || TO_NATIVE(this) || strpbrk(CHAR(this), special)!=NULL;
+        last = this;
+      }
+    }
+    #pragma omp critical(getMaxStringLen)
+    {
+      if (mymax>max) max=mymax;
+      anySpecial |= mySpecial;
+    }
   }
+  if (plain) *plain = special && !anySpecial;
   return max;
 }
 
 int getMaxCategLen(SEXP col) {
   col = getAttrib(col, R_LevelsSymbol);
   if (!isString(col)) error(_("Internal error: col passed to getMaxCategLen is missing levels"));
-  return getMaxStringLen( STRING_PTR(col), LENGTH(col) );
+  return getMaxStringLen( STRING_PTR(col), LENGTH(col), NULL, 1, NULL );
 }
 
 const char *getCategString(SEXP col, int64_t row) {
@@ -53,6 +77,18 @@ const char *getCategString(SEXP col, int64_t row) {
   return x==NA_INTEGER ? NULL : ENCODED_CHAR(STRING_ELT(getAttrib(col, R_LevelsSymbol), x-1));
 }
 
+int getCategNLevels(SEXP col) {
+  return LENGTH(getAttrib(col, R_LevelsSymbol));
+}
+
+const char *getCategLevel(SEXP col, int k) {
+  return ENCODED_CHAR(STRING_ELT(getAttrib(col, R_LevelsSymbol), k));
+}
+
+const int32_t *getCategCodes(SEXP col) {
+  return INTEGER(col);
+}
+
 writer_fun_t funs[] = {
   &writeBool8,
   &writeBool32,
@@ -149,7 +185,7 @@ static int32_t whichWriter(SEXP column) {
 
 SEXP fwriteR(
   SEXP DF,                 // any list of same length vectors; e.g. data.frame, data.table
-  SEXP filename_Arg,
+  SEXP filename_Arg,       // NULL to return the output as a raw vector
   SEXP sep_Arg,
   SEXP sep2_Arg,
   SEXP eol_Arg,
@@ -162,25 +198,42 @@ SEXP fwriteR(
   SEXP colNames_Arg,       // TRUE|FALSE
   SEXP logical01_Arg,      // TRUE|FALSE
   SEXP scipen_Arg,
+  SEXP roundtrip_Arg,      // TRUE|FALSE
   SEXP dateTimeAs_Arg,     // 0=ISO(yyyy-mm-dd),1=squash(yyyymmdd),2=epoch,3=write.csv
   SEXP buffMB_Arg,         // [1-1024] default 8MB
   SEXP nThread_Arg,
   SEXP showProgress_Arg,
   SEXP is_gzip_Arg,
+  SEXP is_zstd_Arg,
+  SEXP compressLevel_Arg,  // [0-9] default 6
+  SEXP compressMemLevel_Arg, // [1-9] default 8
   SEXP bom_Arg,
   SEXP yaml_Arg,
   SEXP verbose_Arg,
-  SEXP encoding_Arg
+  SEXP encoding_Arg,
+  SEXP partFiles_Arg,      // NULL, or a file name for each partition when by= is used
+  SEXP partRows_Arg,       // the order of the rows grouped by partition
+  SEXP partEnd_Arg,        // the (cumulative) number of rows at the end of each partition
+  SEXP handle_Arg          // NULL, or the external pointer from fwriteOpenR to append to instead of filename
   )
 {
   if (!isNewList(DF)) error(_("fwrite must be passed an object of type list; e.g. data.frame, data.table"));
 
   fwriteMainArgs args = {0};  // {0} to quieten valgrind's uninitialized, #4639
   args.is_gzip = LOGICAL(is_gzip_Arg)[0];
+  args.is_zstd = LOGICAL(is_zstd_Arg)[0];
+  args.compressLevel = INTEGER(compressLevel_Arg)[0];
+  args.compressMemLevel = INTEGER(compressMemLevel_Arg)[0];
   args.bom = LOGICAL(bom_Arg)[0];
   args.yaml = CHAR(STRING_ELT(yaml_Arg, 0));
   args.verbose = LOGICAL(verbose_Arg)[0];
-  args.filename = CHAR(STRING_ELT(filename_Arg, 0));
+  MemSink mem = {0};
+  if (isNull(filename_Arg)) {
+    args.filename = "";
+    args.mem = &mem;
+  } else {
+    args.filename = CHAR(STRING_ELT(filename_Arg, 0));
+  }
   args.ncol = length(DF);
   if (args.ncol==0) {
     warning(_("fwrite was passed an empty list of no columns. Nothing to write."));
@@ -231,6 +284,7 @@ SEXP fwriteR(
   dateTimeAs = INTEGER(dateTimeAs_Arg)[0];
   logical01 = LOGICAL(logical01_Arg)[0];
   args.scipen = INTEGER(scipen_Arg)[0];
+  args.roundtrip = LOGICAL(roundtrip_Arg)[0];
   utf8 = !strcmp(CHAR(STRING_ELT(encoding_Arg, 0)), "UTF-8");
   native = !strcmp(CHAR(STRING_ELT(encoding_Arg, 0)), "native");
 
@@ -305,8 +359,60 @@ SEXP fwriteR(
   args.nth = INTEGER(nThread_Arg)[0];
   args.showProgress = LOGICAL(showProgress_Arg)[0];
 
+  if (!isNull(partFiles_Arg)) {
+    args.npart = LENGTH(partFiles_Arg);
+    args.partFiles = (const char **)R_alloc(args.npart, sizeof(const char *));
+    int64_t *partEnd = (int64_t *)R_alloc(args.npart, sizeof(int64_t));
+    for (int p=0; p<args.npart; p++) {
+      args.partFiles[p] = CHAR(STRING_ELT(partFiles_Arg, p));
+      partEnd[p] = INTEGER(partEnd_Arg)[p];
+    }
+    args.partEnd = partEnd;
+    args.partRows = INTEGER(partRows_Arg);
+  }
+
+  if (!isNull(handle_Arg)) {
+    args.handle = R_ExternalPtrAddr(handle_Arg);
+    if (!args.handle) error(_("This fwrite handle has been closed"));
+  }
+
   fwriteMain(args);
 
   UNPROTECT(protecti);
-  return(R_NilValue);
+  if (!args.mem) return(R_NilValue);
+  // the one allocation of the result, now that its size is known
+  SEXP ans = PROTECT(allocVector(RAWSXP, mem.len));
+  if (mem.len) memcpy(RAW(ans), mem.buff, mem.len);
+  free(mem.buff);
+  UNPROTECT(1);
+  return(ans);
+}
+
+static void fwriteHandleFinalizer(SEXP ptr)
+{
+  fwriteHandle *h = R_ExternalPtrAddr(ptr);
+  if (!h) return;
+  fwriteClose(h);  // nothing can be reported from a finalizer
+  R_ClearExternalPtr(ptr);
+}
+
+SEXP fwriteOpenR(SEXP filename_Arg, SEXP append_Arg)
+{
+  const char *filename = CHAR(STRING_ELT(filename_Arg, 0));
+  fwriteHandle *h = fwriteOpen(filename, LOGICAL(append_Arg)[0]);
+  if (!h) error(_("%s: '%s'. Unable to open the file for writing."), strerror(errno), filename);
+  SEXP ptr = PROTECT(R_MakeExternalPtr(h, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, fwriteHandleFinalizer, TRUE);  // closes the file if fwriteClose() is never called
+  UNPROTECT(1);
+  return ptr;
+}
+
+SEXP fwriteCloseR(SEXP handle_Arg, SEXP filename_Arg)
+{
+  fwriteHandle *h = R_ExternalPtrAddr(handle_Arg);
+  if (!h) return R_NilValue;  // already closed
+  R_ClearExternalPtr(handle_Arg);
+  int err = fwriteClose(h);
+  if (err) error(_("%s: '%s'"), strerror(err), CHAR(STRING_ELT(filename_Arg, 0)));  // # nocov
+  return R_NilValue;
 }
@@ -37,6 +37,7 @@ SEXP sym_tzone;
 SEXP sym_old_fread_datetime_character;
 SEXP sym_variable_table;
 SEXP sym_as_character;
+SEXP sym_schema;
 double NA_INT64_D;
 long long NA_INT64_LL;
 Rcomplex NA_CPLX;
@@ -61,8 +62,15 @@ SEXP chin_R();
 SEXP fifelseR();
 SEXP fcaseR();
 SEXP freadR();
+void initLazyStrings(DllInfo *info);
 SEXP fwriteR();
+SEXP fwriteOpenR();
+SEXP fwriteCloseR();
+SEXP fsaveR();
+SEXP floadR();
 SEXP reorder();
+SEXP reorderIndices();
+SEXP patchIndexR();
 SEXP rbindlist();
 SEXP vecseq();
 SEXP setlistelt();
@@ -129,6 +137,7 @@ SEXP islockedR();
 SEXP allNAR();
 SEXP test_dt_win_snprintf();
 SEXP dt_zlib_version();
+SEXP dt_has_zlib();
 SEXP startsWithAny();
 SEXP convertDate();
 
@@ -153,7 +162,13 @@ R_CallMethodDef callMethods[] = {
 {"Cchin", (DL_FUNC) &chin_R, -1},
 {"CfreadR", (DL_FUNC) &freadR, -1},
 {"CfwriteR", (DL_FUNC) &fwriteR, -1},
+{"CfwriteOpenR", (DL_FUNC) &fwriteOpenR, -1},
+{"CfwriteCloseR", (DL_FUNC) &fwriteCloseR, -1},
+{"CfsaveR", (DL_FUNC) &fsaveR, -1},
+{"CfloadR", (DL_FUNC) &floadR, -1},
 {"Creorder", (DL_FUNC) &reorder, -1},
+{"CreorderIndices", (DL_FUNC) &reorderIndices, -1},
+{"CpatchIndexR", (DL_FUNC) &patchIndexR, -1},
 {"Crbindlist", (DL_FUNC) &rbindlist, -1},
 {"Cvecseq", (DL_FUNC) &vecseq, -1},
 {"Csetlistelt", (DL_FUNC) &setlistelt, -1},
@@ -227,6 +242,7 @@ R_CallMethodDef callMethods[] = {
 {"CcoerceAs", (DL_FUNC) &coerceAs, -1},
 {"Ctest_dt_win_snprintf", (DL_FUNC)&test_dt_win_snprintf, -1},
 {"Cdt_zlib_version", (DL_FUNC)&dt_zlib_version, -1},
+{"Cdt_has_zlib", (DL_FUNC)&dt_has_zlib, -1},
 {"Csubstitute_call_arg_namesR", (DL_FUNC) &substitute_call_arg_namesR, -1},
 {"CstartsWithAny", (DL_FUNC)&startsWithAny, -1},
 {"CconvertDate", (DL_FUNC)&convertDate, -1},
@@ -372,8 +388,10 @@ void attribute_visible R_init_data_table(DllInfo *info)
   sym_old_fread_datetime_character = install("datatable.old.fread.datetime.character");
   sym_variable_table = install("variable_table");
   sym_as_character = install("as.character");
+  sym_schema = install("schema");
 
   initDTthreads();
+  initLazyStrings(info);
   avoid_openmp_hang_within_fork();
 }
 
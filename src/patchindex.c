@@ -0,0 +1,219 @@
+#include "data.table.h"
+
+// A secondary index is the order of the rows by its columns, as forderv(x, cols) returns it: ascending, NA first, ties in
+// row order. When only a few rows change (by := or set()) or are appended (by rbind), the index can be patched in one pass
+// rather than being dropped and rebuilt by a full forder on its next use: the rows which changed are taken out of the
+// index, sorted by their new values, and each one inserted where a binary search of the rest of the index puts it.
+
+enum {PI_INT, PI_DBL, PI_INT64, PI_CPLX, PI_STR};
+static int pi_ncol = 0;         // qsort() passes no context to its comparator; only set from the main thread
+static int pi_type[64];
+static const void *pi_data[64];
+
+static int keycmp(const int a, const int b)
+// a and b are 1-based row numbers; 0 when their values in the index columns are equal
+{
+  for (int j=0; j<pi_ncol; ++j) {
+    switch(pi_type[j]) {
+    case PI_INT: {
+      const int x=((const int *)pi_data[j])[a-1], y=((const int *)pi_data[j])[b-1];  // NA_INTEGER is INT_MIN so NA is first
+      if (x!=y) return x<y ? -1 : 1;
+    } break;
+    case PI_DBL: {
+      const uint64_t x=dtwiddle(((const double *)pi_data[j])[a-1]), y=dtwiddle(((const double *)pi_data[j])[b-1]);
+      if (x!=y) return x<y ? -1 : 1;
+    } break;
+    case PI_INT64: {
+      const int64_t x=((const int64_t *)pi_data[j])[a-1], y=((const int64_t *)pi_data[j])[b-1];  // NA is INT64_MIN
+      if (x!=y) return x<y ? -1 : 1;
+    } break;
+    case PI_CPLX: {
+      const Rcomplex x=((const Rcomplex *)pi_data[j])[a-1], y=((const Rcomplex *)pi_data[j])[b-1];
+      uint64_t u=dtwiddle(x.r), v=dtwiddle(y.r);
+      if (u==v) { u=dtwiddle(x.i); v=dtwiddle(y.i); }
+      if (u!=v) return u<v ? -1 : 1;
+    } break;
+    case PI_STR: {
+      const SEXP x=((const SEXP *)pi_data[j])[a-1], y=((const SEXP *)pi_data[j])[b-1];
+      const int c = StrCmp(x, y);  // all ASCII or UTF-8, checked by pi_setup(), so the bytes compare as forder's do
+      if (c) return c;
+    } break;
+    }
+  }
+  return 0;
+}
+
+static int rowcmp(const int a, const int b)
+{
+  const int c = keycmp(a, b);
+  return c ? c : (a<b ? -1 : (a>b));  // ties stay in row order
+}
+
+static int rowcmp_qsort(const void *a, const void *b) {
+  return rowcmp(*(const int *)a, *(const int *)b);
+}
+
+static bool pi_setup(SEXP dt, const int *cols, const int ncol)
+// false if one of the columns is of a type that can't be compared here, or holds a string in a native encoding which
+// would have to be translated to UTF-8 to compare it as forder does; translating allocates, so not in a comparator
+{
+  if (ncol<1 || ncol>64) return false;
+  for (int j=0; j<ncol; ++j) {
+    SEXP col = VECTOR_ELT(dt, cols[j]);
+    switch(TYPEOF(col)) {
+    case LGLSXP: case INTSXP: pi_type[j]=PI_INT; break;
+    case REALSXP: pi_type[j] = INHERITS(col, char_integer64) ? PI_INT64 : PI_DBL; break;
+    case CPLXSXP: pi_type[j]=PI_CPLX; break;
+    case STRSXP: {
+      const SEXP *xd = STRING_PTR(col);
+      const int n = LENGTH(col);
+      bool native = false;
+      #pragma omp parallel for num_threads(getDTthreads(n, true)) reduction(||:native)
+      for (int i=0; i<n; ++i) native = native || NEED2UTF8(xd[i]);
+      if (native) return false;
+      pi_type[j]=PI_STR;
+    } break;
+    default: return false;
+    }
+    pi_data[j] = DATAPTR_RO(col);
+  }
+  pi_ncol = ncol;
+  return true;
+}
+
+SEXP patchIndex(SEXP dt, SEXP o, const int nidx, const int *cols, const int ncol, const int *rows, const int nrows)
+// o is an index of the first nidx rows of dt (integer() when they are in order); any rows of dt after those are new.
+// rows are the 1-based rows whose values in cols have changed, in any order (NA, 0 and repeats are ignored).
+// Returns the index of all the rows of dt, or R_NilValue if one of the columns can't be compared by pi_setup().
+{
+  const int n = length(VECTOR_ELT(dt, 0));
+  if (nidx>n || (length(o)!=nidx && length(o)!=0)) error(_("Internal error: index of %d rows passed to patchIndex for %d of %d rows"), length(o), nidx, n);  // # nocov
+  if (!pi_setup(dt, cols, ncol)) return R_NilValue;
+  const int *od = length(o) ? INTEGER(o) : NULL;  // NULL for 1:nidx
+  uint8_t *changed = (uint8_t *)R_alloc(n, sizeof(uint8_t));
+  memset(changed, 0, n);
+  int *ch = (int *)R_alloc(nrows + (n-nidx), sizeof(int));
+  int nch = 0;
+  for (int i=0; i<nrows; ++i) {
+    const int r = rows[i];
+    if (r==NA_INTEGER || r<1 || r>n || changed[r-1]) continue;
+    changed[r-1] = 1;
+    ch[nch++] = r;
+  }
+  for (int r=nidx+1; r<=n; ++r) if (!changed[r-1]) { changed[r-1]=1; ch[nch++]=r; }  // the new rows not already listed
+  SEXP ans = PROTECT(allocVector(INTSXP, n));
+  int *ansd = INTEGER(ans);
+  // 1. the rows which haven't changed, in their order in the index. Each thread takes one contiguous part of the index.
+  const int nth = getDTthreads(nidx, true);
+  const int nblock = nth, blocksize = nidx==0 ? 1 : (nidx-1)/nblock + 1;
+  int *kept = (int *)R_alloc(nblock, sizeof(int));
+  #pragma omp parallel for num_threads(nth)
+  for (int b=0; b<nblock; ++b) {
+    const int from=b*blocksize, to=MIN(from+blocksize, nidx);
+    int k=0;
+    for (int i=from; i<to; ++i) k += !changed[(od ? od[i] : i+1)-1];
+    kept[b] = k;
+  }
+  int m = 0;
+  for (int b=0; b<nblock; ++b) { const int k=kept[b]; kept[b]=m; m+=k; }
+  #pragma omp parallel for num_threads(nth)
+  for (int b=0; b<nblock; ++b) {
+    const int from=b*blocksize, to=MIN(from+blocksize, nidx);
+    int w = kept[b];
+    for (int i=from; i<to; ++i) {
+      const int r = od ? od[i] : i+1;
+      if (!changed[r-1]) ansd[w++] = r;
+    }
+  }
+  if (m+nch != n) error(_("Internal error: patching an index of %d rows kept %d and inserted %d"), n, m, nch);  // # nocov
+  // 2. the changed rows in order of their new values
+  qsort(ch, nch, sizeof(int), rowcmp_qsort);
+  // 3. merge from the end: each changed row goes where a binary search of the kept rows before it puts it, so only the
+  //    kept rows after it are moved up, and each of those just once
+  int hi = m;  // kept rows ansd[0..hi) have not been moved yet
+  for (int j=nch-1; j>=0; --j) {
+    const int r = ch[j];
+    int lo=0, up=hi;
+    while (lo<up) {
+      const int mid = lo + (up-lo)/2;
+      if (rowcmp(ansd[mid], r) < 0) lo=mid+1; else up=mid;
+    }
+    if (hi>lo) memmove(ansd+lo+j+1, ansd+lo, (hi-lo)*sizeof(int));
+    ansd[lo+j] = r;
+    hi = lo;
+  }
+  bool identity = true;
+  #pragma omp parallel for num_threads(getDTthreads(n, true)) reduction(&&:identity)
+  for (int i=0; i<n; ++i) identity = identity && ansd[i]==i+1;
+  UNPROTECT(1);
+  return identity ? allocVector(INTSXP, 0) : ans;
+}
+
+static int intcmp_qsort(const void *a, const void *b) {
+  const int x=*(const int *)a, y=*(const int *)b;
+  return x<y ? -1 : (x>y);
+}
+
+bool sortIndexTies(SEXP dt, int *o, const int n, const int *cols, const int ncol)
+// o is the order of the n rows of dt by cols but the rows within each run of equal values may be in any order; e.g. once
+// setkey has renumbered the rows. Sorts each such run by row number, as forder leaves ties. Returns false, leaving o as
+// it is, if one of the columns can't be compared by pi_setup().
+{
+  if (!pi_setup(dt, cols, ncol)) return false;
+  if (n<2) return true;
+  uint8_t *starts = (uint8_t *)R_alloc(n, sizeof(uint8_t));  // 1 where a run of equal values starts; found before o is written
+  const int nth = getDTthreads(n, true);
+  starts[0] = 1;
+  #pragma omp parallel for num_threads(nth)
+  for (int i=1; i<n; ++i) starts[i] = keycmp(o[i-1], o[i])!=0;
+  const int nblock = nth, blocksize = (n-1)/nblock + 1;
+  #pragma omp parallel for num_threads(nth)
+  for (int b=0; b<nblock; ++b) {
+    // each block sorts the runs which start in it, the last one running on past the end of the block if need be
+    int i=b*blocksize;
+    const int to=MIN(i+blocksize, n);
+    while (i<to && !starts[i]) i++;
+    while (i<to) {
+      int j=i+1;
+      bool sorted = true;
+      for (; j<n && !starts[j]; ++j) sorted = sorted && o[j-1]<o[j];
+      if (!sorted) qsort(o+i, j-i, sizeof(int), intcmp_qsort);
+      i = j;
+    }
+  }
+  return true;
+}
+
+int indexColumns(SEXP names, const char *name, int *cols)
+// name is an index name after its leading "__"; e.g. "col1__col2". Puts the 0-based column numbers in cols (room for 64)
+// and returns how many, or 0 if one of them is not a column of names.
+{
+  int ncol=0;
+  for (const char *p=name; *p; ) {
+    const char *e = strstr(p, "__");
+    const int len = e ? (int)(e-p) : (int)strlen(p);
+    int j=0;
+    while (j<LENGTH(names) && (strncmp(CHAR(STRING_ELT(names,j)), p, len) || CHAR(STRING_ELT(names,j))[len]!='\0')) j++;
+    if (j==LENGTH(names) || ncol==64) return 0;
+    cols[ncol++] = j;
+    if (!e) break;
+    p = e+2;
+  }
+  return ncol;
+}
+
+SEXP patchIndexR(SEXP dt, SEXP o, SEXP nidxArg, SEXP cols, SEXP rows)
+// for rbindlist(), whose result starts with the nidx rows of its first item; cols are 1-based
+{
+  if (!isNewList(dt) || !length(dt)) error(_("Internal error: dt passed to patchIndex is not a list of columns"));  // # nocov
+  if (!isInteger(o) || !isInteger(cols) || !isInteger(rows))
+    error(_("Internal error: o, cols and rows passed to patchIndex must be integer"));  // # nocov
+  const int ncol = length(cols);
+  int *c = (int *)R_alloc(ncol, sizeof(int));
+  for (int j=0; j<ncol; ++j) {
+    c[j] = INTEGER(cols)[j]-1;
+    if (c[j]<0 || c[j]>=length(dt)) error(_("Internal error: column %d passed to patchIndex is out of range"), c[j]+1);  // # nocov
+  }
+  if (!isInteger(nidxArg) || LENGTH(nidxArg)!=1) error(_("Internal error: nidx passed to patchIndex must be a single integer"));  // # nocov
+  return patchIndex(dt, o, INTEGER(nidxArg)[0], c, ncol, INTEGER(rows), length(rows));
+}
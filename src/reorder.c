@@ -104,6 +104,74 @@ SEXP reorder(SEXP x, SEXP order)
   return R_NilValue;
 }
 
+SEXP reorderIndices(SEXP x, SEXP order)
+{
+  // For internal use only by setkey(), after reorder(x, order).
+  // Each secondary index holds row numbers of x before the reorder. Row order[i] is now row i+1, so each index is mapped
+  // through the inverse of order rather than being dropped and rebuilt on the next join using it. The rows with equal
+  // values keep their relative order in the index but not necessarily their order by row number, so each run of them is
+  // then sorted by row number as forder would leave it; an index whose columns can't be compared to find those runs is
+  // dropped. An index which becomes 1:n (e.g. one on the leading columns of the new key) is stored as integer() as usual.
+  SEXP index = getAttrib(x, sym_index);
+  if (isNull(index) || isNull(ATTRIB(index))) return R_NilValue;
+  const bool verbose = GetVerbose();
+  double tt = wallclock();
+  SEXP names = getAttrib(x, R_NamesSymbol);
+  const int nrow = length(order);
+  const int *restrict o = INTEGER(order);  // already checked by reorder() to be a permutation of 1:nrow
+  const int nth = getDTthreads(nrow, true);
+  int *restrict inv = (int *)R_alloc(nrow, sizeof(int));
+  #pragma omp parallel for num_threads(nth)
+  for (int i=0; i<nrow; ++i) inv[o[i]-1] = i+1;
+  int nindex = 0, ndrop = 0;
+  for (SEXP s=ATTRIB(index); s!=R_NilValue; s=CDR(s)) {
+    SEXP v = CAR(s);
+    if (!isInteger(v) || (LENGTH(v)!=nrow && LENGTH(v)!=0))
+      error(_("Internal error: index '%s' exists but is invalid"), CHAR(PRINTNAME(TAG(s))));  // # nocov
+    int cols[64];
+    const char *name = CHAR(PRINTNAME(TAG(s)));
+    const int ncol = strncmp(name, "__", 2) ? 0 : indexColumns(names, name+2, cols);
+    if (LENGTH(v)==0) {
+      // x was already in this index's order, so the index is now order's inverse
+      v = PROTECT(allocVector(INTSXP, nrow));
+      memcpy(INTEGER(v), inv, nrow*sizeof(int));
+    } else {
+      // in place unless the index is also referenced elsewhere; e.g. by a shallow copy of x
+      if (MAYBE_SHARED(v)) v = duplicate(v);
+      PROTECT(v);
+      int *restrict vd = INTEGER(v);
+      #pragma omp parallel for num_threads(nth)
+      for (int i=0; i<nrow; ++i) vd[i] = inv[vd[i]-1];
+    }
+    if (!ncol || !sortIndexTies(x, INTEGER(v), nrow, cols, ncol)) {
+      setAttrib(index, TAG(s), R_NilValue);  // as assign() drops an index; s still leads on to the next one
+      UNPROTECT(1);
+      ndrop++;
+      continue;
+    }
+    const int *vd = INTEGER(v);
+    bool identity = true;
+    #pragma omp parallel for num_threads(nth) reduction(&&:identity)
+    for (int i=0; i<nrow; ++i) identity = identity && vd[i]==i+1;
+    if (identity) {
+      SEXP empty = PROTECT(allocVector(INTSXP, 0));
+      DUPLICATE_ATTRIB(empty, v);  // keep retGrp's starts and maxgrpn, which refer to positions in the index and are unchanged
+      SETCAR(s, empty);
+      UNPROTECT(1);
+    } else if (CAR(s)!=v) {
+      if (LENGTH(CAR(s))==0) DUPLICATE_ATTRIB(v, CAR(s));
+      SETCAR(s, v);
+    }
+    UNPROTECT(1);
+    nindex++;
+  }
+  if (verbose) {
+    Rprintf(_("Remapped %d secondary %s through the new order in %.3fs\n"), nindex, nindex==1 ? "index" : "indices", wallclock()-tt);
+    if (ndrop) Rprintf(_("Dropped %d secondary %s whose ties could not be put back in row order\n"), ndrop, ndrop==1 ? "index" : "indices");
+  }
+  return R_NilValue;
+}
+
 SEXP setcolorder(SEXP x, SEXP o)
 {
   SEXP names = getAttrib(x, R_NamesSymbol);
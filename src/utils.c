@@ -379,6 +379,13 @@ SEXP dt_zlib_version() {
 #endif
   return ScalarString(mkChar(out));
 }
+SEXP dt_has_zlib() {
+#ifndef NOZLIB
+  return ScalarLogical(TRUE);
+#else
+  return ScalarLogical(FALSE);
+#endif
+}
 
 SEXP startsWithAny(const SEXP x, const SEXP y, SEXP start) {
   // for is_url in fread.R added in #5097